@@ -17,10 +17,29 @@ class index {
 public:
   static constexpr char *filename = "index.mustache"; // with .mustache ext
   static const char *content() {
-    return "<!doctype html><title>{{title}}</title>\n";
+    return "<!doctype html><title>{{title}}</title>\n"
+           "{{> header}}\n"
+           "<table>\n"
+           "{{#sensors}}<tr><td>{{name}}</td><td>{{value}}</td></tr>\n"
+           "{{/sensors}}"
+           "</table>\n"
+           "{{^sensors}}<p>No sensors</p>\n{{/sensors}}";
   }
 };
 
+// Included with {{> header}}
+class header {
+public:
+  static const char *content() { return "<h1>{{title}}</h1>"; }
+};
+
+struct Sensor {
+  const char *name;
+  uint8_t pin;
+};
+
+Sensor sensors[] = {{"A0", A0}, {"A3", A3}, {"A6", A6}};
+
 void setup() {
   LOG_SETUP();
 
@@ -32,11 +51,27 @@ void setup() {
   app.set("view engine", "mustache");
   app.set("views", __dirname + "/views");
 
+  // optional: compile the template now, instead of on the first request
+  mustache::compile(index::filename, index::content());
+
+  mustache::partial(F("header"), header::content);
+
   app.get(F("/"), [](request &req, response &res, const NextCallback next) {
     locals_t locals;
     locals[F("title")] = F("hello world!");
+
+    // {{#sensors}} pulls its rows while the page is sent, one row at a time
+    sections_t sections;
+    sections[F("sensors")] = [](size_t index, locals_t &row) {
+      if (index >= sizeof(sensors) / sizeof(*sensors))
+        return false;
+      row[F("name")] = sensors[index].name;
+      row[F("value")] = String(analogRead(sensors[index].pin));
+      return true;
+    };
+
     File file{index::filename, index::content};
-    res.render(file, locals);
+    res.render(file, locals, sections);
   });
 
   app.listen(80, []() { LOG_I(F("Example app listening on port"), app.port); });
@@ -11,27 +11,32 @@ using namespace EXPRESS_NAMESPACE;
 
 EXPRESS_CREATE_INSTANCE();
 
-int contentLength = 0;
-
-auto getContentLength(request &req, response &res, const NextCallback next)
-    -> void {
-  contentLength = req.headers[ContentLength].toInt();
-  LOG_V(F("1st middleware: contentLength"), contentLength);
-  next(nullptr);
-}
-
 void setup() {
   LOG_SETUP();
 
   ethernet_setup();
 
+  // read the body in chunks the size of the W5500 socket buffer
+  app.bufferPool.configure(2048);
+
+  // state for this route only, shared by the handlers below. Routes live as
+  // long as the app, and so does this.
+  struct Upload {
+    int contentLength = 0;
+  };
+  const auto upload = new Upload();
+
   // 2 middleware handlers, these will be executed in the same order as they are
-  // defined. so: getContentLength before express::raw(). This way you can get
+  // defined. so: the first one before express::raw(). This way you can get
   // the ContentLength and use that in the events handlers 'data' and 'end' (eg
-  // to show % done). const MiddlewareCallback handlers[] = { getContentLength,
-  // express::raw() };
-  const std::vector<MiddlewareCallback> handlers = {getContentLength,
-                                                    express::raw()};
+  // to show % done).
+  const std::vector<MiddlewareCallback> handlers = {
+      [upload](request &req, response &res, const NextCallback next) {
+        upload->contentLength = req.headers[ContentLength].toInt();
+        LOG_V(F("1st middleware: contentLength"), upload->contentLength);
+        next(nullptr);
+      },
+      express::raw()};
 
   route &route =
       app.post("/firmware", handlers,
@@ -40,11 +45,13 @@ void setup() {
                  res.sendStatus(HttpStatus::ACCEPTED);
                });
 
-  route.on(F("data"), [](const Buffer &chunck) {
-    LOG_V(F("data"), contentLength, F("chunck len:"), chunck.length);
+  route.on(F("data"), [upload](const Buffer &chunck) {
+    LOG_V(F("data"), upload->contentLength, F("chunck len:"), chunck.length);
   });
 
-  route.on(F("end"), []() { LOG_V(F("end")); });
+  route.on(F("end"), []() {
+    LOG_V(F("end, max chunks in use:"), app.bufferPool.highWater());
+  });
 
   app.listen(80, []() { LOG_I(F("Example app listening on port"), app.port); });
 }
@@ -0,0 +1,65 @@
+// Generated by extras/bundle.py from data, do not edit.
+
+#pragma once
+
+#include <Express.h>
+
+static const uint8_t assets_index_html[] PROGMEM = {
+    0x3c, 0x21, 0x44, 0x4f, 0x43, 0x54, 0x59, 0x50, 0x45, 0x20, 0x68, 0x74, 0x6d, 0x6c, 0x3e, 0x0a,
+    0x3c, 0x68, 0x74, 0x6d, 0x6c, 0x3e, 0x0a, 0x20, 0x20, 0x3c, 0x68, 0x65, 0x61, 0x64, 0x3e, 0x0a,
+    0x20, 0x20, 0x20, 0x20, 0x3c, 0x6d, 0x65, 0x74, 0x61, 0x20, 0x63, 0x68, 0x61, 0x72, 0x73, 0x65,
+    0x74, 0x3d, 0x22, 0x75, 0x74, 0x66, 0x2d, 0x38, 0x22, 0x20, 0x2f, 0x3e, 0x0a, 0x20, 0x20, 0x20,
+    0x20, 0x3c, 0x74, 0x69, 0x74, 0x6c, 0x65, 0x3e, 0x45, 0x78, 0x70, 0x72, 0x65, 0x73, 0x73, 0x3c,
+    0x2f, 0x74, 0x69, 0x74, 0x6c, 0x65, 0x3e, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x3c, 0x6c, 0x69, 0x6e,
+    0x6b, 0x20, 0x72, 0x65, 0x6c, 0x3d, 0x22, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x73, 0x68, 0x65, 0x65,
+    0x74, 0x22, 0x20, 0x68, 0x72, 0x65, 0x66, 0x3d, 0x22, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x2e, 0x63,
+    0x73, 0x73, 0x22, 0x20, 0x2f, 0x3e, 0x0a, 0x20, 0x20, 0x3c, 0x2f, 0x68, 0x65, 0x61, 0x64, 0x3e,
+    0x0a, 0x20, 0x20, 0x3c, 0x62, 0x6f, 0x64, 0x79, 0x3e, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x3c, 0x68,
+    0x31, 0x3e, 0x48, 0x65, 0x6c, 0x6c, 0x6f, 0x20, 0x66, 0x72, 0x6f, 0x6d, 0x20, 0x66, 0x6c, 0x61,
+    0x73, 0x68, 0x3c, 0x2f, 0x68, 0x31, 0x3e, 0x0a, 0x20, 0x20, 0x20, 0x20, 0x3c, 0x70, 0x3e, 0x54,
+    0x68, 0x69, 0x73, 0x20, 0x70, 0x61, 0x67, 0x65, 0x2c, 0x20, 0x61, 0x6e, 0x64, 0x20, 0x69, 0x74,
+    0x73, 0x20, 0x73, 0x74, 0x79, 0x6c, 0x65, 0x20, 0x73, 0x68, 0x65, 0x65, 0x74, 0x2c, 0x20, 0x61,
+    0x72, 0x65, 0x20, 0x65, 0x6d, 0x62, 0x65, 0x64, 0x64, 0x65, 0x64, 0x20, 0x69, 0x6e, 0x20, 0x74,
+    0x68, 0x65, 0x20, 0x66, 0x69, 0x72, 0x6d, 0x77, 0x61, 0x72, 0x65, 0x2e, 0x3c, 0x2f, 0x70, 0x3e,
+    0x0a, 0x20, 0x20, 0x3c, 0x2f, 0x62, 0x6f, 0x64, 0x79, 0x3e, 0x0a, 0x3c, 0x2f, 0x68, 0x74, 0x6d,
+    0x6c, 0x3e, 0x0a, 0x00,
+};
+static const char *assets_index_html_contents() {
+  return reinterpret_cast<const char *>(assets_index_html);
+}
+static const uint8_t assets_index_html_gz[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x35, 0x8f, 0xb1, 0x6e, 0xc3, 0x30,
+    0x0c, 0x44, 0xf7, 0x7e, 0x05, 0xeb, 0xb9, 0x8d, 0x91, 0xad, 0x83, 0xe2, 0xa5, 0x31, 0x90, 0x2d,
+    0x19, 0xb2, 0x74, 0x54, 0xa2, 0x53, 0x29, 0x44, 0xb2, 0x0d, 0x91, 0x41, 0x9a, 0xbf, 0xaf, 0x6a,
+    0xa9, 0x13, 0x8f, 0xf7, 0x88, 0x3b, 0xd0, 0xbc, 0xee, 0x8f, 0x9f, 0xe7, 0xaf, 0xd3, 0x48, 0xac,
+    0x29, 0x0e, 0x2f, 0xa6, 0x0e, 0x22, 0xc3, 0xb0, 0xee, 0x4f, 0x14, 0x99, 0xa0, 0x96, 0xae, 0x6c,
+    0xb3, 0x40, 0x77, 0xdd, 0x5d, 0xfd, 0xfb, 0x47, 0x47, 0x7d, 0x83, 0x1a, 0x34, 0x62, 0x18, 0x7f,
+    0x96, 0x0c, 0x11, 0xd3, 0xd7, 0xb5, 0xa2, 0x18, 0xa6, 0x1b, 0x65, 0xc4, 0x5d, 0x27, 0xfa, 0x8c,
+    0x10, 0x06, 0xb4, 0x23, 0xce, 0xf0, 0xcd, 0xd9, 0x5c, 0x45, 0x5a, 0x92, 0xe9, 0xff, 0x0b, 0xcd,
+    0x65, 0x76, 0xcf, 0x96, 0xc0, 0xdb, 0xe1, 0x80, 0x18, 0x67, 0xf2, 0x79, 0x4e, 0xe4, 0xa3, 0x15,
+    0x2e, 0x87, 0xdb, 0x46, 0x97, 0xe1, 0xcc, 0x41, 0x68, 0xb1, 0xdf, 0x78, 0x23, 0x3b, 0x39, 0x0a,
+    0x2a, 0xb4, 0x06, 0xd3, 0xda, 0x55, 0xcc, 0x0c, 0x42, 0xba, 0xc0, 0x39, 0x14, 0x3a, 0x91, 0x32,
+    0xc8, 0x87, 0x9c, 0x1e, 0x05, 0x6c, 0x4c, 0xbf, 0xd4, 0xe6, 0x5a, 0x58, 0x82, 0xd7, 0xdf, 0x7f,
+    0x01, 0x18, 0xf9, 0x7f, 0x82, 0x13, 0x01, 0x00, 0x00, 0x00,
+};
+
+static const uint8_t assets_style_css[] PROGMEM = {
+    0x62, 0x6f, 0x64, 0x79, 0x20, 0x7b, 0x0a, 0x20, 0x20, 0x66, 0x6f, 0x6e, 0x74, 0x2d, 0x66, 0x61,
+    0x6d, 0x69, 0x6c, 0x79, 0x3a, 0x20, 0x73, 0x61, 0x6e, 0x73, 0x2d, 0x73, 0x65, 0x72, 0x69, 0x66,
+    0x3b, 0x0a, 0x20, 0x20, 0x6d, 0x61, 0x72, 0x67, 0x69, 0x6e, 0x3a, 0x20, 0x32, 0x65, 0x6d, 0x20,
+    0x61, 0x75, 0x74, 0x6f, 0x3b, 0x0a, 0x20, 0x20, 0x6d, 0x61, 0x78, 0x2d, 0x77, 0x69, 0x64, 0x74,
+    0x68, 0x3a, 0x20, 0x34, 0x30, 0x65, 0x6d, 0x3b, 0x0a, 0x7d, 0x0a, 0x0a, 0x68, 0x31, 0x20, 0x7b,
+    0x0a, 0x20, 0x20, 0x63, 0x6f, 0x6c, 0x6f, 0x72, 0x3a, 0x20, 0x23, 0x32, 0x62, 0x36, 0x63, 0x62,
+    0x30, 0x3b, 0x0a, 0x7d, 0x0a, 0x00,
+};
+static const char *assets_style_css_contents() {
+  return reinterpret_cast<const char *>(assets_style_css);
+}
+
+// path, contents, size, type, hash, mtime, gzip, gzipLength, gzipHash
+static constexpr EXPRESS_NAMESPACE::Asset assets_table[] = {
+    {"/index.html", assets_index_html_contents, 275, "text/html", 0x61ed1f74, 0, assets_index_html_gz, 201, 0x5d85ad7a},
+    {"/style.css", assets_style_css_contents, 101, "text/css", 0x3d16c766, 0, nullptr, 0, 0x00000000},
+};
+
+static constexpr EXPRESS_NAMESPACE::Assets assets{assets_table, 2};
@@ -0,0 +1,30 @@
+// #define LOGGER Serial
+// #define LOG_LOGLEVEL LOG_LOGLEVEL_VERBOSE
+
+// #define PLATFORM ESP32
+#define PLATFORM ESP32_W5500
+
+#include <Express.h>
+using namespace EXPRESS_NAMESPACE;
+
+#include "ethernet_setup.h"
+
+// Generated from the data directory, run again after changing the files:
+//   python3 extras/bundle.py examples/assets/data -o examples/assets/assets.h
+#include "assets.h"
+
+EXPRESS_CREATE_INSTANCE();
+
+void setup() {
+  LOG_SETUP();
+
+  ethernet_setup();
+
+  // GET /          -> data/index.html
+  // GET /style.css -> data/style.css (gzip when accepted)
+  app.use(F("/"), express::Static(assets));
+
+  app.listen(80, []() { LOG_I(F("Example app listening on port"), app.port); });
+}
+
+void loop() { app.run(); }
@@ -0,0 +1,71 @@
+// #define LOGGER Serial
+// #define LOG_LOGLEVEL LOG_LOGLEVEL_VERBOSE
+
+// #define PLATFORM ESP32
+#define PLATFORM ESP32_W5500
+
+#include <Express.h>
+using namespace EXPRESS_NAMESPACE;
+
+#include <middlewares/cache.h>
+
+#include "ethernet_setup.h"
+
+EXPRESS_CREATE_INSTANCE();
+
+// at most 4 KB of responses, kept for a minute unless a route says otherwise
+ResponseCache pages(4096, 60 * 1000);
+
+String deviceName = F("sensor-1");
+
+void setup() {
+  LOG_SETUP();
+
+  ethernet_setup();
+
+  // Built once, then replayed from the cache (in one write) until it
+  // expires or is invalidated
+  app.get(F("/info"), cache(pages),
+          [](request &req, response &res, const NextCallback next) {
+            auto json = res.json();
+            json.beginObject()
+                .key(F("name"))
+                .value(deviceName)
+                .key(F("uptime"))
+                .value(millis() / 1000)
+                .endObject();
+          });
+
+  // a shorter time to live for this route
+  app.get(F("/time"), cache(pages, 5000),
+          [](request &req, response &res, const NextCallback next) {
+            res.send(String(millis()));
+          });
+
+  // the data behind /info changes: drop what is cached
+  app.post(F("/name"), [](request &req, response &res, const NextCallback next) {
+    deviceName = req.query[F("name")];
+    pages.invalidate(F("/info"));
+    res.sendStatus(HttpStatus::OK);
+  });
+
+  app.get(F("/stats"), [](request &req, response &res, const NextCallback next) {
+    auto json = res.json();
+    json.beginObject()
+        .key(F("hits"))
+        .value((unsigned long)pages.hits)
+        .key(F("misses"))
+        .value((unsigned long)pages.misses)
+        .key(F("hitRatio"))
+        .value(pages.hitRatio())
+        .key(F("bytesSaved"))
+        .value((unsigned long)pages.bytesSaved)
+        .key(F("bytes"))
+        .value((unsigned long)pages.size())
+        .endObject();
+  });
+
+  app.listen(80, []() { LOG_I(F("Example app listening on port"), app.port); });
+}
+
+void loop() { app.run(); }
@@ -0,0 +1,38 @@
+// #define LOGGER Serial
+// #define LOG_LOGLEVEL LOG_LOGLEVEL_VERBOSE
+
+// #define PLATFORM ESP32
+#define PLATFORM ESP32_W5500
+
+#include <Express.h>
+using namespace EXPRESS_NAMESPACE;
+
+#include "ethernet_setup.h"
+
+EXPRESS_CREATE_INSTANCE();
+
+void setup() {
+  LOG_SETUP();
+
+  ethernet_setup();
+
+  // The table is never assembled in memory: each row is written as it is
+  // produced and sent with Transfer-Encoding: chunked.
+  app.get(F("/table"), [](request &req, response &res, const NextCallback next) {
+    res.set(F("content-type"), F("text/csv"));
+
+    res.write(F("n,square\n"));
+    for (auto n = 0; n < 1000; n++) {
+      res.write(String(n));
+      res.write(F(","));
+      res.write(String(n * n));
+      res.write(F("\n"));
+    }
+
+    res.end();
+  });
+
+  app.listen(80, []() { LOG_I(F("Example app listening on port"), app.port); });
+}
+
+void loop() { app.run(); }
@@ -0,0 +1,41 @@
+// #define LOGGER Serial
+// #define LOG_LOGLEVEL LOG_LOGLEVEL_VERBOSE
+
+// #define PLATFORM ESP32
+#define PLATFORM ESP32_W5500
+
+// history the compressor can refer back to (uses about 8x in RAM)
+// #define EXPRESS_DEFLATE_WINDOW 2048
+
+#include <Express.h>
+#include <middlewares/compression.h>
+using namespace EXPRESS_NAMESPACE;
+
+#include "ethernet_setup.h"
+
+EXPRESS_CREATE_INSTANCE();
+
+void setup() {
+  LOG_SETUP();
+
+  ethernet_setup();
+
+  // compress everything that follows, when larger than 512 bytes
+  app.use(compression(512));
+
+  app.get(F("/readings"), [](request &req, response &res, const NextCallback next) {
+    auto json = res.json();
+
+    json.beginArray();
+    for (auto i = 0; i < 500; i++)
+      json.beginObject()
+          .key(F("sensor")).value(i % 4)
+          .key(F("millis")).value(millis())
+          .endObject();
+    json.endArray();
+  });
+
+  app.listen(80, []() { LOG_I(F("Example app listening on port"), app.port); });
+}
+
+void loop() { app.run(); }
@@ -11,15 +11,66 @@ using namespace EXPRESS_NAMESPACE;
 
 EXPRESS_CREATE_INSTANCE();
 
+const char *users[] = {"Tobi", "Loki", "Jane"};
+
 void setup() {
   LOG_SETUP();
 
   ethernet_setup();
 
+  // The same users, as HTML, plain text or JSON: whatever the client prefers
+  // according to its Accept header. Try:
+  //   curl -H "Accept: text/plain" http://<ip>/
+  //   curl -H "Accept: application/json" http://<ip>/
   app.get(F("/"), [](request &req, response &res, const NextCallback next) {
-    res.status(HttpStatus::OK).send(F("Hello World!"));
+    res.format({
+        {F("html"),
+         [&res]() {
+           String body = F("<ul>");
+           for (auto user : users) {
+             body += F("<li>");
+             body += user;
+             body += F("</li>");
+           }
+           body += F("</ul>");
+           res.send(body);
+         }},
+        {F("text"),
+         [&res]() {
+           String body;
+           for (auto user : users) {
+             body += F(" - ");
+             body += user;
+             body += F("\n");
+           }
+           res.send(body);
+         }},
+        {F("json"),
+         [&res]() {
+           auto json = res.json();
+           json.beginArray();
+           for (auto user : users)
+             json.beginObject().key(F("name")).value(user).endObject();
+           json.endArray();
+         }},
+    });
   });
 
+  // req.accepts() on its own, when a route serves one type only
+  app.get(F("/users.json"),
+          [](request &req, response &res, const NextCallback next) {
+            if (req.accepts(F("json")) == F("")) {
+              res.sendStatus(HttpStatus::NONE_ACCEPTABLE);
+              return;
+            }
+
+            auto json = res.json();
+            json.beginArray();
+            for (auto user : users)
+              json.value(user);
+            json.endArray();
+          });
+
   app.listen(80, []() { LOG_I(F("Example app listening on port"), app.port); });
 }
 
@@ -0,0 +1,49 @@
+// #define LOGGER Serial
+// #define LOG_LOGLEVEL LOG_LOGLEVEL_VERBOSE
+
+// #define PLATFORM ESP32
+#define PLATFORM ESP32_W5500
+
+#include <Express.h>
+using namespace EXPRESS_NAMESPACE;
+
+#include "ethernet_setup.h"
+
+EXPRESS_CREATE_INSTANCE();
+
+// visits per session, a handful of sessions
+std::map<String, int> sessions;
+
+void setup() {
+  LOG_SETUP();
+
+  ethernet_setup();
+
+  // Shared by every response: rendered into the Set-Cookie header as is
+  static CookieOptions sessionCookie;
+  sessionCookie.httpOnly = true;
+  sessionCookie.sameSite = SameSite::Lax;
+
+  app.get(F("/"), [](request &req, response &res, const NextCallback next) {
+    // the Cookie header is only parsed here, on first access
+    auto sid = req.cookies[F("sid")];
+    if (sid == F("") || sessions.find(sid) == sessions.end()) {
+      sid = String(random(0x7fffffff), HEX);
+      sessions[sid] = 0;
+      res.cookie(F("sid"), sid, sessionCookie);
+    }
+
+    auto visits = ++sessions[sid];
+    res.send(String(F("Visits this session: ")) + String(visits));
+  });
+
+  app.get(F("/logout"), [](request &req, response &res, const NextCallback next) {
+    sessions.erase(req.cookies[F("sid")]);
+    res.clearCookie(F("sid"));
+    res.send(F("Bye"));
+  });
+
+  app.listen(80, []() { LOG_I(F("Example app listening on port"), app.port); });
+}
+
+void loop() { app.run(); }
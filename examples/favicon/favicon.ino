@@ -11,8 +11,6 @@ using namespace EXPRESS_NAMESPACE;
 
 EXPRESS_CREATE_INSTANCE();
 
-Buffer *favicon;
-
 void setup() {
   LOG_SETUP();
 
@@ -22,7 +20,8 @@ void setup() {
     res.send(F("Hello World!"));
   });
 
-  favicon =
+  // decoded once, kept for the route
+  const auto favicon =
       Buffer::from("AAABAAEAEBAQAAAAAAAoAQAAFgAAACgAAAAQAAAAIAAAAAEABAAAAAAAgAA"
                    "AAAAAAAAAAAAAEAAAAAAAAAAAAAAA/"
                    "4QAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
@@ -33,7 +32,7 @@ void setup() {
                    "AAD//wAA+98AAP//AAD//wAA//8AAP//AAD//wAA",
                    "base64");
   app.get(F("/favicon.ico"),
-          [](request &req, response &res, const NextCallback next) {
+          [favicon](request &req, response &res, const NextCallback next) {
             res.status(HttpStatus::OK);
             res.set("Content-Length", String(favicon->length));
             res.set("Content-Type", "image/x-icon");
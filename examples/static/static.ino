@@ -0,0 +1,47 @@
+// #define LOGGER Serial
+// #define LOG_LOGLEVEL LOG_LOGLEVEL_VERBOSE
+
+// #define PLATFORM ESP32
+#define PLATFORM ESP32_W5500
+
+#include <Express.h>
+#include <LittleFS.h>
+using namespace EXPRESS_NAMESPACE;
+
+#include "ethernet_setup.h"
+
+EXPRESS_CREATE_INSTANCE();
+
+// Upload the web UI to the /www directory of LittleFS, eg
+//   /www/index.html
+//   /www/app.js
+//   /www/app.js.gz    (optional, pre-compressed: sent to clients that accept
+//                      gzip, with Content-Encoding: gzip)
+//
+// GET /ui           -> 301 to /ui/
+// GET /ui/          -> /www/index.html
+// GET /ui/app.js    -> /www/app.js (or app.js.gz)
+// GET /ui/.hidden   -> 404 (dotfiles are ignored)
+
+void setup() {
+  LOG_SETUP();
+
+  ethernet_setup();
+
+  if (!LittleFS.begin())
+    LOG_E(F("LittleFS mount failed"));
+
+  static Options options;
+  options.maxAge = 60 * 60 * 1000; // ms
+
+  // files below /www are served below /ui, other URLs fall through
+  app.use(F("/ui"), express::Static(LittleFS, F("/www"), &options));
+
+  app.get(F("/"), [](request &req, response &res, const NextCallback next) {
+    res.send(F("the UI is at /ui/"));
+  });
+
+  app.listen(80, []() { LOG_I(F("Example app listening on port"), app.port); });
+}
+
+void loop() { app.run(); }
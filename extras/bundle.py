@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+"""Turns a directory into a header of embedded assets for express::Static.
+
+    python3 extras/bundle.py data/www -o src/assets.h
+
+Every file becomes a byte array in flash and a constexpr Asset entry with
+its length, MIME type (from the MimeType table of the library), strong ETag
+hash (FNV-1a, as computed by the library) and modification time. Text based
+files also get a gzip variant when that is smaller. The entries are sorted
+by path, Assets::find is a binary search over them.
+
+    #include "assets.h"
+    app.use(F("/ui"), express::Static(assets));
+"""
+
+import argparse
+import gzip
+import os
+import re
+import sys
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+MIME_TABLE = os.path.join(HERE, "..", "src", "mimeType", "mimeType.cpp")
+
+# see MimeType::compressible
+COMPRESSIBLE_SUFFIXES = ("+json", "+xml", "+yaml")
+COMPRESSIBLE = ("application/json", "application/json5", "application/hjson",
+                "application/xml", "application/xml-dtd",
+                "application/javascript", "application/x-javascript",
+                "application/ecmascript", "application/yaml",
+                "application/x-yaml", "application/wasm", "image/bmp",
+                "image/x-icon", "image/vnd.microsoft.icon", "font/ttf",
+                "font/otf")
+
+
+def mime_types():
+    """extension -> type, read from the table the library uses"""
+    with open(MIME_TABLE, encoding="utf-8") as f:
+        source = f.read()
+    table = source[source.index("MimeType::types["):]
+    types = {}
+    for extension, type in re.findall(r'\{"([^"]+)",\s*"([^"]+)"\}', table):
+        types.setdefault(extension.lower(), type)
+    return types
+
+
+def compressible(type):
+    type = type.split(";")[0].strip().lower()
+    return (type.startswith("text/") and len(type) > 5
+            or type.endswith(COMPRESSIBLE_SUFFIXES) or type in COMPRESSIBLE)
+
+
+def fnv1a(data):
+    """FNV-1a, 32 bits, like _Response::hash"""
+    hash = 2166136261
+    for byte in data:
+        hash ^= byte
+        hash = (hash * 16777619) & 0xFFFFFFFF
+    return hash
+
+
+def identifier(name, path):
+    return name + "_" + re.sub(r"[^0-9A-Za-z]", "_", path.strip("/"))
+
+
+def array(out, name, data):
+    """a byte array, terminated by a 0 that is not part of the contents (so
+    text can be used as a C string)"""
+    out.write("static const uint8_t %s[] PROGMEM = {\n" % name)
+    data = data + b"\0"
+    for i in range(0, len(data), 16):
+        out.write("    " + ", ".join("0x%02x" % b for b in data[i:i + 16]) +
+                  ",\n")
+    out.write("};\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("directory", help="files to embed")
+    parser.add_argument("-o", "--output", help="header (default: stdout)")
+    parser.add_argument("-n", "--name", default="assets",
+                        help="name of the Assets table (default: assets)")
+    parser.add_argument("--no-gzip", action="store_true",
+                        help="no pre-compressed variants")
+    parser.add_argument("--no-mtime", action="store_true",
+                        help="no Last-Modified (reproducible output)")
+    args = parser.parse_args()
+
+    types = mime_types()
+
+    files = []
+    for root, dirs, names in os.walk(args.directory):
+        dirs[:] = [d for d in dirs if not d.startswith(".")]
+        for name in names:
+            if name.startswith("."):
+                continue
+            full = os.path.join(root, name)
+            path = "/" + os.path.relpath(full, args.directory).replace(os.sep, "/")
+            files.append((path, full))
+
+    if not files:
+        parser.error("no files in " + args.directory)
+
+    # byte order, as compared by Assets::find
+    files.sort(key=lambda file: file[0].encode("utf-8"))
+
+    out = open(args.output, "w", encoding="utf-8") if args.output else sys.stdout
+
+    out.write("// Generated by extras/bundle.py from %s, do not edit.\n\n" %
+              os.path.basename(os.path.normpath(args.directory)))
+    out.write("#pragma once\n\n#include <Express.h>\n\n")
+
+    entries = []
+    ids = set()
+    total = 0
+    for path, full in files:
+        with open(full, "rb") as f:
+            data = f.read()
+
+        extension = os.path.splitext(path)[1][1:].lower()
+        type = types.get(extension)
+        id = identifier(args.name, path)
+        while id in ids:
+            id += "_"
+        ids.add(id)
+
+        array(out, id, data)
+        out.write("static const char *%s_contents() {\n"
+                  "  return reinterpret_cast<const char *>(%s);\n}\n" % (id, id))
+        total += len(data)
+
+        gz = None
+        if not args.no_gzip and type and compressible(type):
+            gz = gzip.compress(data, 9, mtime=0)
+            if len(gz) < len(data):
+                array(out, id + "_gz", gz)
+                total += len(gz)
+            else:
+                gz = None
+        out.write("\n")
+
+        mtime = 0 if args.no_mtime else int(os.path.getmtime(full))
+        literal = path.replace("\\", "\\\\").replace('"', '\\"')
+        entries.append("    {\"%s\", %s_contents, %d, %s, 0x%08x, %d, %s, %d, 0x%08x}," % (
+            literal, id, len(data), '"%s"' % type if type else "nullptr",
+            fnv1a(data), mtime,
+            id + "_gz" if gz else "nullptr", len(gz) if gz else 0,
+            fnv1a(gz) if gz else 0))
+
+    out.write("// path, contents, size, type, hash, mtime, gzip, gzipLength, "
+              "gzipHash\n")
+    out.write("static constexpr EXPRESS_NAMESPACE::Asset %s_table[] = {\n" %
+              args.name)
+    out.write("\n".join(entries) + "\n};\n\n")
+    out.write("static constexpr EXPRESS_NAMESPACE::Assets %s{%s_table, %d};\n" %
+              (args.name, args.name, len(entries)))
+
+    if args.output:
+        out.close()
+    print("%d files, %d bytes" % (len(entries), total), file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
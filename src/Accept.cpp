@@ -0,0 +1,147 @@
+#include "Express.h"
+#include "mimeType/mimeType.h"
+
+#include <algorithm>
+
+BEGIN_EXPRESS_NAMESPACE
+
+/// @brief
+auto Accept::matches(const MediaRange &range, const char *type,
+                     const size_t length) const -> bool {
+  return range.length == length &&
+         strncasecmp(header.c_str() + range.offset, type, length) == 0;
+}
+
+/// @brief quality value (0..1) in thousandths
+static auto parseQuality(const char *str) -> uint16_t {
+  const auto q = atof(str);
+  if (q <= 0)
+    return 0;
+  if (q >= 1)
+    return 1000;
+  return uint16_t(q * 1000 + 0.5);
+}
+
+/// @brief
+auto Accept::parse(const String &header) -> void {
+  count = 0;
+  this->header = header;
+
+  const char *p = this->header.c_str();
+  while (*p) {
+    // media range: type/subtype *( ; parameter )
+    while (*p == ' ' || *p == ',')
+      p++;
+    const auto start = p;
+    while (*p && *p != ',' && *p != ';' && *p != ' ')
+      p++;
+    const size_t length = p - start;
+
+    uint16_t q = 1000;
+    while (*p && *p != ',') {
+      if (*p == ';') {
+        p++;
+        while (*p == ' ')
+          p++;
+        if ((p[0] == 'q' || p[0] == 'Q') && p[1] == '=')
+          q = parseQuality(p + 2);
+      } else
+        p++;
+    }
+
+    const auto slash = static_cast<const char *>(memchr(start, '/', length));
+    const size_t offset = start - this->header.c_str();
+    if (length == 0 || nullptr == slash || offset + length > UINT16_MAX)
+      continue;
+
+    MediaRange range{Unknown, uint16_t(offset), uint16_t(length), q};
+    if (length == 3 && start[0] == '*')
+      range.type = Any;
+    else if (slash[1] == '*') {
+      range.type = AnySubtype;
+      range.length = slash - start;
+    } else {
+      range.type = MimeType::id(start, length);
+      if (range.type < 0)
+        range.type = Unknown;
+    }
+
+    // insertion sort on quality, stable: equal quality keeps the order of
+    // the header. When full, the range with the lowest quality makes room
+    // (or this one is dropped)
+    if (count == EXPRESS_ACCEPT_MAX_RANGES) {
+      if (ranges[count - 1].q >= q)
+        continue;
+      count--;
+    }
+    auto i = count++;
+    for (; i > 0 && ranges[i - 1].q < q; i--)
+      ranges[i] = ranges[i - 1];
+    ranges[i] = range;
+  }
+}
+
+/// @brief
+auto Accept::best(const String *types, const size_t count) const -> int {
+  if (this->count == 0)
+    return count > 0 ? 0 : -1;
+
+  int best = -1;
+  uint16_t bestQ = 0;
+  int bestSpecificity = -1;
+  int bestIndex = EXPRESS_ACCEPT_MAX_RANGES;
+
+  for (size_t t = 0; t < count; t++) {
+    auto type = types[t].c_str();
+    if (nullptr == strchr(type, '/')) {
+      type = MimeType::getType(type); // extension
+      if (nullptr == type)
+        continue;
+    }
+
+    const auto length = strlen(type);
+    const auto slash = strchr(type, '/');
+    const int16_t id = MimeType::id(type, length);
+
+    // the most specific media range that matches decides the quality
+    int specificity = -1;
+    int index = 0;
+    for (uint8_t i = 0; i < this->count; i++) {
+      const auto &range = ranges[i];
+      int s = -1;
+      if (range.type == Any)
+        s = 0;
+      else if (range.type == AnySubtype)
+        s = matches(range, type, slash - type) ? 1 : -1;
+      else if (range.type == Unknown)
+        s = matches(range, type, length) ? 2 : -1;
+      else
+        s = range.type == id ? 2 : -1;
+
+      if (s > specificity) {
+        specificity = s;
+        index = i;
+      }
+    }
+
+    if (specificity < 0)
+      continue;
+
+    const auto q = ranges[index].q;
+    if (q == 0)
+      continue;
+
+    if (q > bestQ ||
+        (q == bestQ && (specificity > bestSpecificity ||
+                        (specificity == bestSpecificity && index < bestIndex)))) {
+      best = t;
+      bestQ = q;
+      bestSpecificity = specificity;
+      bestIndex = index;
+    }
+  }
+
+  return best;
+}
+
+END_EXPRESS_NAMESPACE
@@ -1,31 +1,316 @@
-constexpr size_t rawBufferSize = 1024;
+#ifndef EXPRESS_BUFFER_CHUNK_SIZE
+/// @brief Size of the chunks a request body is read in (and handed to the
+/// "data" callbacks). Match it to the socket buffer (W5500: 2 KB by default)
+/// or to the page size of the flash the data ends up in.
+#define EXPRESS_BUFFER_CHUNK_SIZE 1024
+#endif
 
+#ifndef EXPRESS_BUFFER_POOL_SIZE
+/// @brief Number of released chunks the pool keeps for reuse, instead of
+/// returning them to the heap.
+#define EXPRESS_BUFFER_POOL_SIZE 2
+#endif
+
+class BufferPool;
+
+/// @brief Memory behind one or more Buffer handles: header and data in a
+/// single allocation.
+struct BufferBlock {
+  /// @brief owner, nullptr when not pooled (freed when no longer referenced)
+  BufferPool *pool;
+  /// @brief free list of the pool
+  BufferBlock *next;
+  std::atomic<uint16_t> refs;
+  size_t capacity;
+
+  auto data() -> byte * { return reinterpret_cast<byte *>(this + 1); }
+
+  /// @brief
+  static auto create(const size_t capacity, BufferPool *pool) -> BufferBlock * {
+    auto block = static_cast<BufferBlock *>(
+        malloc(sizeof(BufferBlock) + capacity));
+    if (nullptr == block)
+      return nullptr;
+    block->pool = pool;
+    block->next = nullptr;
+    new (&block->refs) std::atomic<uint16_t>(1);
+    block->capacity = capacity;
+    return block;
+  }
+};
+
+/// @brief Reference counted handle to a chunk of bytes. Copying a Buffer
+/// shares the bytes (no copy), the memory is released (or returned to its
+/// pool) when the last handle goes away. So a chunk handed to a "data"
+/// callback can be kept, and processed later, without copying it.
 class Buffer {
+private:
+  BufferBlock *block_ = nullptr;
+
+  auto retain() -> void {
+    if (block_)
+      block_->refs++;
+  }
+
+  inline auto release() -> void;
+
 public:
-  byte buffer[rawBufferSize]{};
+  /// @brief start of the memory (not of the data, see byteOffset)
+  byte *buffer = nullptr;
   size_t byteOffset = 0;
   size_t length = 0;
 
+  /// @brief empty handle
+  Buffer() {}
+
+  /// @brief Allocates capacity bytes from the heap (not pooled)
+  explicit Buffer(const size_t capacity)
+      : Buffer(BufferBlock::create(capacity, nullptr)) {}
+
+  /// @brief takes over the reference to block
+  explicit Buffer(BufferBlock *block) : block_(block) {
+    if (block_)
+      buffer = block_->data();
+  }
+
+  Buffer(const Buffer &other)
+      : block_(other.block_), buffer(other.buffer),
+        byteOffset(other.byteOffset), length(other.length) {
+    retain();
+  }
+
+  Buffer(Buffer &&other)
+      : block_(other.block_), buffer(other.buffer),
+        byteOffset(other.byteOffset), length(other.length) {
+    other.block_ = nullptr;
+    other.buffer = nullptr;
+    other.byteOffset = other.length = 0;
+  }
+
+  Buffer &operator=(const Buffer &other) {
+    if (this != &other) {
+      Buffer copy(other);
+      swap(copy);
+    }
+    return *this;
+  }
+
+  Buffer &operator=(Buffer &&other) {
+    if (this != &other) {
+      release();
+      swap(other);
+    }
+    return *this;
+  }
+
+  ~Buffer() { release(); }
+
+  /// @brief
+  auto swap(Buffer &other) -> void {
+    std::swap(block_, other.block_);
+    std::swap(buffer, other.buffer);
+    std::swap(byteOffset, other.byteOffset);
+    std::swap(length, other.length);
+  }
+
+  /// @brief size of the memory behind the handle
+  auto capacity() const -> size_t { return block_ ? block_->capacity : 0; }
+
+  /// @brief number of handles sharing the memory
+  auto useCount() const -> uint16_t { return block_ ? block_->refs.load() : 0; }
+
+  /// @brief
+  auto data() const -> const byte * { return buffer + byteOffset; }
+
+  /// @brief Like Node's buf.subarray(): a handle to part of the data, sharing
+  /// the memory.
+  /// @param start
+  /// @param end exclusive, clamped to the length
+  /// @return
+  auto subarray(size_t start, size_t end = SIZE_MAX) const -> Buffer {
+    end = std::min(end, length);
+    start = std::min(start, end);
+
+    Buffer part(*this);
+    part.byteOffset += start;
+    part.length = end - start;
+    return part;
+  }
+
+  /// @brief Creates a Buffer from a string. With encoding "base64" the
+  /// string is decoded (straight into the buffer), otherwise the text is
+  /// copied as is.
+  /// @param data
+  /// @param encoding "base64" (default), "binary", "utf8", ...
+  /// @return
   static Buffer *from(const String &data,
                       const String &encoding = F("base64")) {
-    Buffer *buffer = new Buffer();
+    const auto base64 = encoding.equalsIgnoreCase(F("base64"));
+    Buffer *buffer = new Buffer(base64 ? Base64::decodedLength(data.length())
+                                       : data.length());
 
-    buffer->length = data.length();
-    memcpy(buffer->buffer, data.c_str(), data.length());
+    if (base64) {
+      const auto n = Base64::decode(data.c_str(), data.length(),
+                                    buffer->buffer, buffer->capacity());
+      if (n < 0)
+        LOG_E(F("invalid base64"));
+      else
+        buffer->length = n;
+    } else {
+      buffer->length = buffer->capacity();
+      memcpy(buffer->buffer, data.c_str(), buffer->length);
+    }
 
-    LOG_V(F("encoded length"), buffer->length);
+    LOG_V(F("decoded length"), buffer->length);
 
     return buffer;
   }
 
-  String toString() {
-    return "AAABAAEAEBAQAAAAAAAoAQAAFgAAACgAAAAQAAAAIAAAAAEABAAAAAAAgAAAAAAAAAA"
-           "AAAAAEAAAAAAAAAAAAAAA/"
-           "4QAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA"
-           "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAEREQAAAAAAEAAAEAAAA"
-           "AEAAAABAAAAEAAAAAAQAAAQAAAAABAAAAAAAAAAAAAAAAAAAAAAAAAAEAABAAAAAAAA"
-           "AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAD//wAA//8AAP//"
-           "AAD8HwAA++8AAPf3AADv+wAA7/sAAP//AAD//wAA+98AAP//AAD//wAA//8AAP//"
-           "AAD//wAA";
+  /// @brief The bytes as a String (binary safe)
+  String toString() const {
+    String str;
+    str.concat(reinterpret_cast<const char *>(data()), length);
+    return str;
   }
 };
+
+/// @brief Hands out Buffers of a fixed (configurable) chunk size and keeps a
+/// few released ones for reuse, so reading a body does not hit the heap for
+/// every chunk. Tracks how many chunks are in use, and the maximum (high
+/// water mark), to size EXPRESS_BUFFER_POOL_SIZE and the heap.
+/// Buffers may be released from another task than the one acquiring them.
+class BufferPool {
+  friend class Buffer;
+
+private:
+  size_t chunkSize_;
+  size_t keep_;
+
+  BufferBlock *free_ = nullptr;
+  size_t freeCount_ = 0;
+
+  size_t inUse_ = 0;
+  size_t highWater_ = 0;
+
+  /// @brief FreeRTOS critical section: held for a few instructions only,
+  /// never around malloc or free
+  portMUX_TYPE lock_ = portMUX_INITIALIZER_UNLOCKED;
+
+  auto lock() -> void { portENTER_CRITICAL(&lock_); }
+  auto unlock() -> void { portEXIT_CRITICAL(&lock_); }
+
+  /// @brief called when the last handle to a block goes away
+  auto recycle(BufferBlock *block) -> void {
+    lock();
+    inUse_--;
+    if (block->capacity == chunkSize_ && freeCount_ < keep_) {
+      block->next = free_;
+      free_ = block;
+      freeCount_++;
+      block = nullptr;
+    }
+    unlock();
+
+    free(block);
+  }
+
+  /// @brief frees a (detached) free list
+  static auto drain(BufferBlock *block) -> void {
+    while (block) {
+      const auto next = block->next;
+      free(block);
+      block = next;
+    }
+  }
+
+public:
+  /// @brief
+  /// @param chunkSize size of every Buffer handed out
+  /// @param keep number of released chunks kept for reuse
+  BufferPool(const size_t chunkSize = EXPRESS_BUFFER_CHUNK_SIZE,
+             const size_t keep = EXPRESS_BUFFER_POOL_SIZE)
+      : chunkSize_(chunkSize), keep_(keep) {}
+
+  BufferPool(const BufferPool &) = delete;
+  BufferPool &operator=(const BufferPool &) = delete;
+
+  /// @brief Note: Buffers handed out must not outlive the pool
+  ~BufferPool() { drain(free_); }
+
+  /// @brief Changes the chunk size, and the number of chunks kept for reuse.
+  /// Buffers in use keep their size.
+  /// @param chunkSize
+  /// @param keep
+  auto configure(const size_t chunkSize,
+                 const size_t keep = EXPRESS_BUFFER_POOL_SIZE) -> void {
+    lock();
+    chunkSize_ = chunkSize;
+    keep_ = keep;
+    const auto released = free_;
+    free_ = nullptr;
+    freeCount_ = 0;
+    unlock();
+
+    drain(released);
+  }
+
+  /// @brief A Buffer of chunkSize() bytes (empty length), from the pool or
+  /// the heap. Check capacity(): 0 when out of memory.
+  auto acquire() -> Buffer {
+    lock();
+    auto block = free_;
+    if (block) {
+      free_ = block->next;
+      freeCount_--;
+    }
+    const auto size = chunkSize_;
+    unlock();
+
+    if (block)
+      block->refs = 1;
+    else
+      block = BufferBlock::create(size, this);
+
+    if (block) {
+      lock();
+      if (++inUse_ > highWater_)
+        highWater_ = inUse_;
+      unlock();
+    } else
+      LOG_E(F("out of memory for a buffer of"), size);
+
+    return Buffer(block);
+  }
+
+  /// @brief
+  auto chunkSize() const -> size_t { return chunkSize_; }
+
+  /// @brief number of chunks handed out and not yet released
+  auto inUse() const -> size_t { return inUse_; }
+
+  /// @brief maximum number of chunks in use at the same time
+  auto highWater() const -> size_t { return highWater_; }
+
+  /// @brief maximum number of bytes in use at the same time
+  auto highWaterBytes() const -> size_t { return highWater_ * chunkSize_; }
+
+  /// @brief
+  auto resetHighWater() -> void { highWater_ = inUse_; }
+};
+
+/// @brief
+inline auto Buffer::release() -> void {
+  if (nullptr == block_)
+    return;
+
+  if (--block_->refs == 0) {
+    if (block_->pool)
+      block_->pool->recycle(block_);
+    else
+      free(block_);
+  }
+
+  block_ = nullptr;
+  buffer = nullptr;
+  byteOffset = length = 0;
+}
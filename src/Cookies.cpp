@@ -0,0 +1,166 @@
+#include "Express.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+/// @brief Splits "name=value; name2=value2" into spans of the header
+auto Cookies::parse() -> void {
+  parsed_ = true;
+
+  const auto it = headers_.find(F("cookie"));
+  if (it == headers_.end())
+    return;
+
+  header_ = it->second.c_str();
+  const auto end = header_ + it->second.length();
+
+  auto p = header_;
+  while (p < end) {
+    while (p < end && (*p == ' ' || *p == ';'))
+      p++;
+    const auto name = p;
+    while (p < end && *p != '=' && *p != ';')
+      p++;
+    if (p == end || *p != '=')
+      continue; // no value, ignored
+    auto nameEnd = p;
+    while (nameEnd > name && nameEnd[-1] == ' ')
+      nameEnd--;
+
+    auto value = ++p;
+    while (p < end && *p != ';')
+      p++;
+    auto valueEnd = p;
+    while (valueEnd > value && valueEnd[-1] == ' ')
+      valueEnd--;
+    if (valueEnd - value >= 2 && *value == '"' && valueEnd[-1] == '"') {
+      value++;
+      valueEnd--;
+    }
+
+    if (nameEnd == name)
+      continue;
+
+    spans_.push_back({{size_t(name - header_), size_t(nameEnd - name)},
+                      {size_t(value - header_), size_t(valueEnd - value)}});
+  }
+}
+
+/// @brief
+auto Cookies::indexOf(const char *name, const size_t length) -> int {
+  if (!parsed_)
+    parse();
+
+  for (size_t i = 0; i < spans_.size(); i++) {
+    const auto &span = spans_[i].first;
+    if (span.len == length && 0 == memcmp(header_ + span.pos, name, length))
+      return i;
+  }
+  return -1;
+}
+
+/// @brief
+auto Cookies::size() -> size_t {
+  if (!parsed_)
+    parse();
+  return spans_.size();
+}
+
+/// @brief
+auto Cookies::has(const String &name) -> bool {
+  return indexOf(name.c_str(), name.length()) >= 0;
+}
+
+/// @brief
+auto Cookies::find(const char *name, const char *&value, size_t &length)
+    -> bool {
+  const auto i = indexOf(name, strlen(name));
+  if (i < 0)
+    return false;
+
+  value = header_ + spans_[i].second.pos;
+  length = spans_[i].second.len;
+  return true;
+}
+
+/// @brief
+auto Cookies::get(const String &name) -> String {
+  const auto i = indexOf(name.c_str(), name.length());
+  if (i < 0)
+    return String();
+
+  const auto value = header_ + spans_[i].second.pos;
+  const auto length = spans_[i].second.len;
+
+  auto hex = [](char c) -> int {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    c |= 0x20;
+    return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+  };
+
+  String str;
+  str.reserve(length);
+  for (size_t j = 0; j < length; j++) {
+    if (value[j] == '%' && j + 2 < length && hex(value[j + 1]) >= 0 &&
+        hex(value[j + 2]) >= 0) {
+      str += char(hex(value[j + 1]) << 4 | hex(value[j + 2]));
+      j += 2;
+    } else
+      str += value[j];
+  }
+  return str;
+}
+
+/// @brief
+auto Cookies::name(const size_t i) -> String {
+  if (i >= size())
+    return String();
+
+  String str;
+  str.concat(header_ + spans_[i].first.pos, spans_[i].first.len);
+  return str;
+}
+
+/// @brief
+auto CookieOptions::printTo(Print &out) const -> void {
+  if (domain.length() > 0) {
+    out.print(F("; Domain="));
+    out.print(domain);
+  }
+  if (path.length() > 0) {
+    out.print(F("; Path="));
+    out.print(path);
+  }
+  if (maxAge != 0) {
+    out.print(F("; Max-Age="));
+    out.print(maxAge > 0 ? maxAge / 1000 : 0);
+  }
+  if (expires != 0) {
+    struct tm tm;
+    gmtime_r(&expires, &tm);
+    char date[32];
+    strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    out.print(F("; Expires="));
+    out.print(date);
+  }
+  if (httpOnly)
+    out.print(F("; HttpOnly"));
+  if (secure)
+    out.print(F("; Secure"));
+
+  switch (sameSite) {
+  case SameSite::Strict:
+    out.print(F("; SameSite=Strict"));
+    break;
+  case SameSite::Lax:
+    out.print(F("; SameSite=Lax"));
+    break;
+  case SameSite::None:
+    out.print(F("; SameSite=None"));
+    break;
+  default:
+    break;
+  }
+}
+
+END_EXPRESS_NAMESPACE
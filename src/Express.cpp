@@ -24,6 +24,7 @@
  */
 
 #include "Express.h"
+#include "serveStatic/serveStatic.h"
 
 BEGIN_EXPRESS_NAMESPACE
 
@@ -120,8 +121,15 @@ auto _Express::parseRaw(_Request &req, _Response &res, const NextCallback next)
 
     while (dataLen > 0 && req.client.connected()) {
       if (req.client.available()) {
-        Buffer buffer;
-        buffer.length = req.client.read(buffer.buffer, sizeof(buffer.buffer));
+        auto buffer = req.app.bufferPool.acquire();
+        if (buffer.capacity() == 0)
+          break;
+
+        const auto n = req.client.read(
+            buffer.buffer, std::min<size_t>(dataLen, buffer.capacity()));
+        if (n <= 0)
+          continue;
+        buffer.length = n;
         dataLen -= buffer.length;
 
         LOG_V(F("remaining:"), buffer.length, dataLen);
@@ -204,6 +212,62 @@ auto _Express::text() -> MiddlewareCallback { return parseText; }
 /// inflation of gzip and deflate encodings.
 auto _Express::urlencoded() -> MiddlewareCallback { return parseUrlencoded; }
 
+/// @brief This is a built-in middleware function in _Express. It serves
+/// static files and is based on serve-static.
+/// @return a MiddlewareCallback, that calls next() for URLs without a file
+auto _Express::Static(FS &fs, const String &root, Options *options)
+    -> MiddlewareCallback {
+  // owned by the middleware (and its copies)
+  const auto serveStatic = std::make_shared<ServeStatic>(fs, root, options);
+
+  return [serveStatic](_Request &req, _Response &res, const NextCallback next) {
+    serveStatic->handle(req, res, next);
+  };
+}
+
+/// @brief This is a built-in middleware function in _Express. It serves
+/// embedded assets, mounted with app.use(path, ...) like the FS variant.
+/// @return a MiddlewareCallback, that calls next() for URLs without an asset
+auto _Express::Static(const Assets &assets, Options *options)
+    -> MiddlewareCallback {
+  const auto table = &assets;
+  // owned by the middleware (and its copies)
+  const auto defaults = options ? std::make_shared<Options>(options)
+                                : std::make_shared<Options>();
+
+  return [table, defaults](_Request &req, _Response &res,
+                           const NextCallback next) {
+    if (req.method_ != Method::GET && req.method_ != Method::HEAD) {
+      next(nullptr);
+      return;
+    }
+
+    auto url = req.uri.substring(req.baseUrl.length());
+    const auto &index = defaults->index;
+
+    // the mount path itself, or a directory without the trailing slash
+    if ((url == F("") && req.baseUrl != F("")) ||
+        (url != F("") && !url.endsWith(F("/")) && index != F("") &&
+         table->find(url + '/' + index))) {
+      res.set(F("location"), req.uri + F("/") + req.search);
+      res.sendStatus(HttpStatus::MOVED);
+      return;
+    }
+
+    if (url == F("") || url.endsWith(F("/")))
+      url += (url == F("")) ? String('/') + index : index;
+
+    const auto asset = table->find(url);
+    if (nullptr == asset) {
+      next(nullptr);
+      return;
+    }
+
+    res.status(HttpStatus::OK);
+    res.sendFile(asset->file(), defaults.get());
+  };
+}
+
 /// @brief Creates a new _Router object.
 auto _Express::Router() -> _Router & {
   const auto _router = new _Router();
@@ -296,6 +360,9 @@ void _Express::listen(uint16_t port, const Callback startedCallback) {
 
   this->port = port;
 
+  // no more routes after this point, compact the routing state
+  router_->freeze();
+
   // Note: see https://github.com/PaulStoffregen/Ethernet/issues/42
   // change in ESP32 server.h
   // MacOS:
@@ -332,6 +399,8 @@ void _Express::listenAsync(uint16_t port, const Callback startedCallback, int co
     }
     this->port = port;
 
+    router_->freeze();
+
     server = new ServerType(port);
     server->begin();
     
@@ -365,7 +434,7 @@ void _Express::run(ClientType &client) {
       _Request req(*this, client);
 
       if (req.method_ != Method::ERROR) {
-        _Response res(*this, client);
+        _Response res(*this, req, client);
 
         router_->dispatch(req, res);
 
@@ -33,23 +33,32 @@ BEGIN_EXPRESS_NAMESPACE
 class _Request;
 class _Response;
 class _Route;
+class Deflate;
 class _Error;
 class _Router;
 class _Express;
 
 // Callback definitions
-using NextCallback = void (*)(const _Error *error);
-using ErrorCallback = void (*)(_Error &, _Request &, _Response &,
-                               const NextCallback next);
-using MiddlewareCallback = void (*)(_Request &, _Response &,
-                                    const NextCallback next);
-using RenderEngineCallback = void (*)(ClientType &, locals_t &locals, Options *,
-                                      const char *f);
-using Callback = void (*)();
-using DataCallback = void (*)(const Buffer &);
-using EndDataCallback = void (*)();
-using MountCallback = void (*)(_Express *);
-using Write_Callback = void (*)(const char *, const uint &);
+// Note: callbacks accept any callable (function, lambda with or without
+// captures, functor). The callable is stored inline, see InlineFunction.
+using NextCallback = InlineFunction<void(const _Error *error)>;
+using ErrorCallback = InlineFunction<void(_Error &, _Request &, _Response &,
+                                          const NextCallback next)>;
+using MiddlewareCallback =
+    InlineFunction<void(_Request &, _Response &, const NextCallback next)>;
+/// @brief Pulls the rows of a section of a view, one at a time: row holds the
+/// locals of the row. Returns false when there are no more rows.
+using RowsCallback = InlineFunction<bool(size_t index, locals_t &row)>;
+/// @brief row sources of a view, by section name
+using sections_t = std::map<String, RowsCallback>;
+using RenderEngineCallback =
+    InlineFunction<void(Print &, locals_t &locals, const sections_t &sections,
+                        Options *, const File &view)>;
+using Callback = InlineFunction<void()>;
+using DataCallback = InlineFunction<void(const Buffer &)>;
+using EndDataCallback = InlineFunction<void()>;
+using MountCallback = InlineFunction<void(_Express *)>;
+using Write_Callback = InlineFunction<void(const char *, const uint &)>;
 
 /// @brief
 class _Error {
@@ -92,6 +101,10 @@ public:
   /// are valid only for the lifetime of the request.
   locals_t locals;
 
+  /// @brief Chunks a request body is read in (raw body parser). Configure the
+  /// chunk size before listening, check highWater() to size the pool.
+  BufferPool bufferPool;
+
 private:
   // bodyparser
 
@@ -135,11 +148,25 @@ private:
   static auto parseUrlencoded(_Request &, _Response &,
                               const NextCallback callback = nullptr) -> void;
 
+public:
   /// @brief This is a built-in middleware function in _Express. It serves
-  /// static files and is based on serve-static.
-  // static void Static() {}
+  /// static files and is based on serve-static. Mount it on a path with
+  /// app.use(path, ...): the rest of the URL is the file below root.
+  /// @param fs
+  /// @param root directory on the FS, eg "/www"
+  /// @param options see Options (index, dotfiles, maxAge, headers, ...)
+  /// @return
+  static auto Static(FS &fs, const String &root, Options *options = nullptr)
+      -> MiddlewareCallback;
+
+  /// @brief Serves embedded assets (see extras/bundle.py) from flash: the
+  /// metadata is precomputed, nothing is copied to RAM.
+  /// @param assets generated table
+  /// @param options see Options (index, maxAge, headers, ...)
+  /// @return
+  static auto Static(const Assets &assets, Options *options = nullptr)
+      -> MiddlewareCallback;
 
-public:
   /// @brief
   /// @return
   static auto raw() -> MiddlewareCallback;
@@ -353,6 +380,8 @@ public:
 class _Request {
   friend class _Router;
   friend class _Express;
+  friend class _Response;
+  friend class ServeStatic;
 
 public:
   /// @brief
@@ -365,6 +394,14 @@ public:
 
   String uri{};
 
+  /// @brief The query string of the URL as it was sent, with its '?' (empty
+  /// without one), see query for the parsed arguments
+  String search{};
+
+  /// @brief The path on which the current middleware was mounted (app.use with
+  /// a path), uri starts with it.
+  String baseUrl{};
+
   /// @brief
   String body{};
 
@@ -400,6 +437,9 @@ public:
   /// @brief
   std::map<String, String> headers;
 
+  /// @brief Cookies sent by the client, parsed on first access
+  Cookies cookies{headers};
+
   /// @brief Contains the path part of the request URL.
   String path{};
 
@@ -425,14 +465,28 @@ public: /* Methods*/
 
   /// @brief Checks if the specified content types are acceptable, based on the
   /// request’s Accept HTTP header field. The method returns the best match, or
-  /// if none of the specified content types is acceptable, returns false (in
-  /// which case, the application should respond with 406 "Not Acceptable").
-  auto accepts(const String &) -> bool;
+  /// if none of the specified content types is acceptable, returns an empty
+  /// string (in which case, the application should respond with 406 "Not
+  /// Acceptable").
+  /// @param types comma separated MIME types (text/html) or extensions (html)
+  auto accepts(const String &) -> String;
+
+  /// @brief
+  /// @param types MIME types or extensions
+  /// @return index of the best match, -1 when none is acceptable
+  auto accepts(const std::vector<String> &) -> int;
+
+  /// @brief Checks if the encoding (gzip, br, ...) is acceptable, based on
+  /// the request’s Accept-Encoding HTTP header field. An encoding with q=0 is
+  /// not acceptable.
+  auto acceptsEncodings(const String &) -> bool;
 
   /// @brief Returns the matching content type if the incoming request’s
   /// “Content-Type” HTTP header field matches the MIME type specified by the
-  /// type parameter. If the request has no body, returns null. Returns false
+  /// type parameter. Returns an empty string if the request has no body, or
   /// otherwise.
+  /// @param types comma separated MIME types (text/html), wildcards (text/*,
+  /// +json) or extensions (html)
   auto is(const String &) -> String;
 
   /// @brief Range header parser.
@@ -460,6 +514,10 @@ private:
   /// @brief
   Range range_;
 
+  /// @brief Accept header, parsed on first use
+  Accept accept_;
+  bool acceptParsed_ = false;
+
   /// @brief
   Method method_{};
 
@@ -475,8 +533,12 @@ private:
 
 /// @brief
 class _Response {
+  friend class _Router;
+  friend class ServeStatic;
+  friend class ResponseCache;
+
 private:
-  static void renderFile(ClientType &, Options *, const char *f,
+  static void renderFile(Print &, Options *, const char *f, const size_t,
                          const Write_Callback);
 
 public:
@@ -496,33 +558,172 @@ public:
   /// @return
   _Express &app;
 
+  /// @brief The request object that relates to this response object.
+  _Request &req;
+
 private:
   String body_{};
 
+  /// @brief Body bytes that are sent as they are (embedded assets)
+  const uint8_t *raw_ = nullptr;
+  size_t rawLength_ = 0;
+
+  /// @brief Holds the bytes of the Buffer given to end() (raw_ points into
+  /// them) until the body is sent
+  Buffer rawBuffer_{};
+
+  /// @brief File (on a FS) that is streamed as the body
+  fs::File file_{};
+  size_t fileLength_ = 0;
+  /// @brief file_ is a cached handle, it is not closed after sending
+  bool keepFile_ = false;
+
+  /// @brief
+  auto sendOpenFile(fs::File &, const char *type, const size_t size,
+                    const char *encoding, const String &etag,
+                    const String &lastModified, const String &path,
+                    Options *, const bool keepOpen) -> void;
+
+  /// @brief
+  void sendFileBody(Print &);
+
+  /// @brief
+  auto streamFile(Print &, const size_t offset, const size_t length) -> bool;
+
+  /// @brief Partial content: the ranges that are sent and, for
+  /// multipart/byteranges, the header in front of each part followed by the
+  /// closing delimiter
+  std::vector<beginEnd> parts_{};
+  std::vector<String> partHeads_{};
+
+  /// @brief
+  auto byteRanges(Range &, const size_t size) -> void;
+
+  /// @brief
+  void sendRanges(Print &, const char *contents);
+
+  /// @brief Selects a pre-compressed variant of an embedded file
+  auto sendEncoded(const File &) -> bool;
+
+  /// @brief
+  static auto hash(const uint8_t *data, const size_t length,
+                   const uint32_t seed = 2166136261u) -> uint32_t;
+
+  /// @brief
+  static auto etag(const size_t length, const uint32_t hash,
+                   const String &suffix = F("")) -> String;
+
+  /// @brief
+  auto notModified(const String &etag, const String &lastModified = F(""))
+      -> bool;
+
+  /// @brief
+  static auto httpDate(const time_t) -> String;
+
+  /// @brief size of the contents of contentsCallback, 0 is unknown
+  size_t contentsLength_ = 0;
+
+  /// @brief Cache-Control for a file, unless the header is set already
+  auto cacheControl(const String &filename, Options *options) -> void;
+
   /// @brief derefered rendering
   ContentCallback contentsCallback{};
 
   locals_t renderLocals{};
+  sections_t renderSections{};
 
   String filename;
 
   Options *options = nullptr;
 
+  /// @brief HEAD request: send the headers only, the body is not generated
+  bool suppressBody_ = false;
+
+  /// @brief status line, headers and body are assembled in here
+  OutputBuffer out_;
+
+  /// @brief the body is being streamed with write()
+  bool streaming_ = false;
+
+  /// @brief the response has been sent completely
+  bool finished_ = false;
+
+  /// @brief see capture()
+  Callback captured_ = nullptr;
+
+  /// @brief Sends the status line and the headers
+  void writeHead();
+
+  /// @brief compress bodies of at least this size, SIZE_MAX is off
+  size_t compressThreshold_ = SIZE_MAX;
+
+  /// @brief compresses the body into the output buffer
+  Deflate *deflate_ = nullptr;
+
+  /// @brief Set-Cookie headers
+  struct SetCookie {
+    String name;
+    String value;
+    CookieOptions options;
+  };
+  std::vector<SetCookie> cookies_;
+
+  /// @brief
+  auto printCookie(const SetCookie &) -> void;
+
+  /// @brief
+  auto negotiateCompression() -> const char *;
+
+  /// @brief where the body is written to: the compressor or the output buffer
+  auto sink() -> Print &;
+
+  /// @brief
+  void finish();
+
+  /// @brief The body as a Print, everything written goes through write()
+  class BodyStream : public Print {
+  private:
+    _Response &res_;
+
+  public:
+    BodyStream(_Response &res) : res_(res) {}
+
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *data, size_t length) override;
+
+    using Print::write;
+  };
+
+  BodyStream stream_;
+
 public:
   /// @brief
-  /// @param client
-  void evaluateHeaders(ClientType &);
+  void evaluateHeaders();
 
   /// @brief
-  /// @param client
-  void sendBody(ClientType &, locals_t &);
+  /// @param out
+  void sendBody(Print &, locals_t &);
 
   /// @brief
   void send();
 
 public: /* Methods*/
   /// @brief Constructor
-  _Response(_Express &, ClientType &);
+  _Response(_Express &, _Request &, ClientType &);
+
+  /// @brief Destructor
+  ~_Response();
+
+  /// @brief Compresses the body (gzip or deflate) when the client accepts it
+  /// and the content-type is compressible. Bodies that are known to be smaller
+  /// than threshold are sent as they are. See the compression middleware.
+  /// @param threshold
+  /// @return
+  auto compress(const size_t threshold = 1024) -> _Response &;
+
+  /// @brief Removes a header that is queued for sending
+  /// @param field
+  auto removeHeader(const String &field) -> void;
 
   /// @brief Appends the specified value to the HTTP response header field. If
   /// the header is not already set, it creates the header with the specified
@@ -543,24 +744,68 @@ public: /* Methods*/
   /// The Content-Type response header is set when a callback is selected.
   /// However, you may alter this within the callback using methods such as
   /// res.set() or res.type().
-  auto format() -> void;
+  /// @param callbacks MIME type (text/html) or extension (html) and its
+  /// callback, in order of preference. "default" for the default callback.
+  auto format(const std::vector<std::pair<String, Callback>> &) -> void;
+
+  /// @brief Adds the field to the Vary response header, if it is not there
+  /// already.
+  /// @param field
+  /// @return
+  auto vary(const String &field) -> _Response &;
 
   auto download(File &) -> void;
 
-  auto cookie() -> void;
+  /// @brief Sets cookie name to value. The Set-Cookie header is written with
+  /// the other headers, straight into the output buffer. Setting a cookie
+  /// twice replaces it. A name that is not a token (RFC 6265), or a Domain or
+  /// Path with control characters or ';', is logged and the cookie not set.
+  /// @param name
+  /// @param value percent-encoded where needed
+  /// @param options
+  /// @return
+  auto cookie(const String &name, const String &value,
+              const CookieOptions &options = CookieOptions()) -> _Response &;
 
-  auto clearCookie(const String &) -> void;
+  /// @brief Clears the cookie specified by name. The path (and domain) must
+  /// be the same as when the cookie was set.
+  /// @param name
+  /// @param options
+  /// @return
+  auto clearCookie(const String &name,
+                   const CookieOptions &options = CookieOptions())
+      -> _Response &;
 
   /// @brief Ends the response process. This method actually comes from Node
   /// core, specifically the response.end() method of http.ServerResponse.
+  /// Ends a body that was streamed with write(), or sends data as the (binary)
+  /// body. The Buffer is not copied, the response keeps a handle to its bytes
+  /// until they are sent.
   /// @param data
   /// @param encoding
   /// @return
   auto end(Buffer *data = nullptr, const String &encoding = F(""))
       -> _Response &;
 
-  /// @brief Ends the response process
-  static void end();
+  /// @brief Sends a chunk of the response body. The status and headers are
+  /// sent with the first chunk, so set them before. Unless a Content-Length
+  /// header was set, the body is sent with Transfer-Encoding: chunked. Only
+  /// one output buffer of data is held in memory, call end() when done.
+  /// @param data
+  /// @param length
+  /// @return
+  auto write(const uint8_t *data, const size_t length) -> _Response &;
+
+  /// @brief
+  /// @param data
+  /// @param length
+  /// @return
+  auto write(const char *data, const size_t length) -> _Response &;
+
+  /// @brief
+  /// @param data
+  /// @return
+  auto write(const String &data) -> _Response &;
 
   /// @brief Returns the HTTP response header specified by field. The match is
   /// case-insensitive.
@@ -574,11 +819,46 @@ public: /* Methods*/
   /// @return
   auto json(const String &body) -> void;
 
+  /// @brief Starts a streamed JSON response, with the correct content-type.
+  /// The document is written straight to the output buffer as the returned
+  /// writer produces it, instead of being built as a String first.
+  /// @return
+  auto json() -> JsonWriter;
+
+  /// @brief The body as a stream, for anything that writes to a Print. See
+  /// write().
+  /// @return
+  auto stream() -> Print &;
+
+  /// @brief Sends a complete response, as serialized before (status line,
+  /// headers and body, eg from a cache), in a single write. Nothing else is
+  /// sent for this request.
+  /// @param data
+  /// @param length
+  auto replay(const uint8_t *data, const size_t length) -> void;
+
+  /// @brief A copy of every byte of the response that is handed to the
+  /// client (status line, headers and body, as on the wire) is also written
+  /// to copy. done is called when the response is complete.
+  /// @param copy
+  /// @param done
+  auto capture(Print &copy, const Callback done) -> void;
+
+  /// @brief
+  /// @return true when a cookie is set (or cleared)
+  auto hasCookies() const -> bool { return !cookies_.empty(); }
+
   /// @brief Sends the HTTP response.
   /// Optional parameters:
   /// @param view
   auto send(const String &body) -> _Response &;
-  ;
+
+  /// @brief Sends a binary body, with its length (no conversion to a String,
+  /// zeros are fine). The bytes are sent after the handler returns and
+  /// must stay valid until then.
+  /// @param data
+  /// @param length
+  auto send(const uint8_t *data, const size_t length) -> _Response &;
 
   /// @brief Renders a view and sends the rendered HTML string to the client.
   /// Optional parameters:
@@ -590,12 +870,20 @@ public: /* Methods*/
   ///      response. When an error occurs, the method invokes next(err)
   ///      internally.
   /// @param view
-  auto render(File &, locals_t &) -> void;
-
-  /// @brief .
-  auto sendFile(FS &fs, const char *filePath) -> void;
+  /// @param locals
+  /// @param sections row sources of the sections of the view (used while the
+  /// body is sent, after the handler has returned)
+  auto render(File &, locals_t &, const sections_t &sections = {}) -> void;
+
+  /// @brief Transfers the file at the given path. When the client accepts
+  /// it, a pre-compressed sibling (filePath + ".br" or ".gz") is sent instead,
+  /// with Content-Encoding. Vary: Accept-Encoding is set whenever a sibling
+  /// exists.
+  auto sendFile(FS &fs, const char *filePath, Options *options = nullptr)
+      -> void;
 
-  /// @brief .
+  /// @brief Transfers an embedded file, or its pre-compressed variant (see
+  /// File) when the client accepts it.
   auto sendFile(const File &, Options *options = nullptr) -> void;
 
   /// @brief Sets the response HTTP status code to statusCode and sends the
@@ -635,19 +923,14 @@ public:
 
   String path{};
 
+  /// @brief Note: moved into the RouteTable (and emptied) when the app starts
+  /// listening.
   std::vector<MiddlewareCallback> middlewares;
 
-  // cache path splitting (avoid doing this for every request * number of paths)
-  std::vector<PosLen> indices;
-
 public:
   /// @brief
   _Route();
 
-  /// @brief
-  /// @param path
-  auto splitToVector(const String &path) -> void;
-
   /// @brief
   /// @param path
   /// @return
@@ -665,6 +948,70 @@ public:
   auto on(const String &name, const EndDataCallback callback) -> void;
 };
 
+/// @brief Read-only, compacted copy of the routing state of an application,
+/// built once by _Router::freeze() when the app starts listening. The routes,
+/// paths and middlewares of all (mounted) routers are stored in a handful of
+/// contiguous arrays that refer to each other by index. Nothing in here is
+/// modified while serving, so it can be read from several tasks.
+struct RouteTable {
+  /// @brief A unique route path
+  struct Path {
+    uint16_t offset;        // in text
+    uint16_t length;
+    uint16_t segmentOffset; // in segments
+    uint16_t segmentCount;
+    uint16_t methods;       // bit per Method with a route on this path
+    uint16_t allowOffset;   // in text, value of the Allow header
+    uint16_t allowLength;
+    uint16_t entryOffset;   // in pathEntries
+    uint16_t entryCount;
+  };
+
+  /// @brief
+  struct Entry {
+    Method method;
+    uint16_t path;          // in paths
+    uint16_t chainOffset;   // in chain
+    uint16_t chainCount;
+    uint16_t handlerOffset; // in chain, first middleware of the route itself
+    uint16_t errorOffset;   // in errorHandlers
+    uint16_t errorCount;
+    _Route *route;
+  };
+
+  /// @brief All unique route paths and their Allow header values, back to
+  /// back
+  String text{};
+
+  /// @brief Path segments, positions are offsets in text
+  std::vector<PosLen> segments{};
+
+  std::vector<Path> paths{};
+
+  std::vector<Entry> entries{};
+
+  /// @brief Per path: its entries, in the order they were registered
+  std::vector<uint16_t> pathEntries{};
+
+  /// @brief Paths without parameters, sorted by their text: a request path
+  /// is found with a binary search
+  std::vector<uint16_t> staticPaths{};
+
+  /// @brief Paths with parameters, matched segment by segment
+  std::vector<uint16_t> paramPaths{};
+
+  /// @brief Per route: the app and router wide middlewares, followed by the
+  /// route middlewares. Starts with the app wide middlewares only (used when
+  /// no route matches).
+  std::vector<MiddlewareCallback> chain{};
+  uint16_t appChainCount = 0;
+
+  /// @brief Per router: its error handlers followed by those of its parents.
+  /// Starts with the app wide error handlers.
+  std::vector<ErrorCallback> errorHandlers{};
+  uint16_t appErrorCount = 0;
+};
+
 /// @brief
 class _Router {
 private:
@@ -687,8 +1034,8 @@ private:
   /// @brief routes
   std::vector<_Route *> routes{};
 
-  /// @brief
-  static bool gotoNext;
+  /// @brief Frozen routing state (root router only), see freeze()
+  RouteTable *table_ = nullptr;
 
 public:
   /// @brief Enable case sensitivity
@@ -710,21 +1057,54 @@ public:
 
 private:
   /// @brief
+  /// @param table
   /// @param path
-  /// @param pathItems
   /// @param requestPath
   /// @param requestPathItems
   /// @param params
   /// @return
-  static auto match(const String &path, const std::vector<PosLen> &pathItems,
+  static auto match(const RouteTable &table, const RouteTable::Path &path,
                     const String &requestPath,
                     const std::vector<PosLen> &requestPathItems,
                     params_t &params) -> bool;
 
   /// @brief
+  /// @return true when the (root) router has been frozen
+  auto frozen() -> bool;
+
+  /// @brief Adds the routes of this router (and its children) to the table
+  /// @param table
+  /// @param chain inherited app and router wide middlewares
+  /// @param errorOffset inherited error handlers
+  /// @param errorCount
+  auto compact(RouteTable &table, std::vector<MiddlewareCallback> chain,
+               const uint16_t errorOffset, const uint16_t errorCount) -> void;
+
+  /// @brief
+  /// @param path
+  /// @return index of the (new) path in the table
+  static auto intern(RouteTable &table, const String &path) -> uint16_t;
+
+  /// @brief
+  /// @param table
+  /// @param method
   /// @param req
-  /// @param res
-  auto evaluate(_Request &, _Response &) -> bool;
+  /// @param requestPathItems
+  /// @return first entry for the method and request path, or nullptr
+  static auto find(const RouteTable &table, const Method method, _Request &req,
+                   const std::vector<PosLen> &requestPathItems)
+      -> const RouteTable::Entry *;
+
+  /// @brief
+  /// @return the path without parameters that equals the request path, or
+  /// nullptr
+  static auto findStatic(const RouteTable &table, const String &requestPath)
+      -> const RouteTable::Path *;
+
+  /// @brief
+  /// @return first entry of the path for the method, or nullptr
+  static auto first(const RouteTable &table, const RouteTable::Path &path,
+                    const Method method) -> const RouteTable::Entry *;
 
   /// https://expressjs.com/en/guide/writing-middleware.html
   /// https://expressjs.com/en/guide/using-middleware.html
@@ -842,6 +1222,11 @@ public:
   /// duplicate route names (and thus typo errors).
   _Route &route(const String &path);
 
+  /// @brief Compacts the routing state of this router and all mounted
+  /// routers into a RouteTable. Called by listen(), routes must be added
+  /// before that.
+  auto freeze() -> void;
+
   /// @brief
   auto dispatch(_Request &, _Response &) -> void;
 
@@ -0,0 +1,310 @@
+#ifndef EXPRESS_JSON_MAX_DEPTH
+/// @brief Maximum nesting of objects and arrays in a JsonWriter
+#define EXPRESS_JSON_MAX_DEPTH 32
+#endif
+
+/// @brief Writes a JSON document to a Print as it is produced, nothing is
+/// collected in memory. Objects and arrays are opened and closed explicitly,
+/// the separators (commas, colons) are added by the writer.
+///
+///   res.json()
+///       .beginObject()
+///       .key(F("uptime")).value(millis())
+///       .key(F("sensors")).beginArray()
+///       .value(21.5).value(22.25)
+///       .endArray()
+///       .endObject();
+class JsonWriter {
+private:
+  Print &out_;
+
+  /// @brief one bit per nesting level: a value was already written there
+  uint32_t hasValue_ = 0;
+  uint8_t depth_ = 0;
+
+  /// @brief a key was written, its value is next
+  bool afterKey_ = false;
+
+  /// @brief nested too deep, nothing more is written
+  bool failed_ = false;
+
+  static_assert(EXPRESS_JSON_MAX_DEPTH <= 32, "nesting is tracked in 32 bits");
+
+  /// @brief writes the separator in front of a value (or key)
+  /// @return false when failed, nothing is to be written
+  auto separate() -> bool {
+    if (failed_)
+      return false;
+    if (afterKey_) {
+      afterKey_ = false;
+      return true;
+    }
+
+    const auto bit = uint32_t(1) << depth_;
+    if (hasValue_ & bit)
+      out_.write(',');
+    hasValue_ |= bit;
+    return true;
+  }
+
+  /// @brief Nesting beyond EXPRESS_JSON_MAX_DEPTH can not be tracked, the
+  /// separators would be wrong. Rather than a document that looks valid but
+  /// is not, the writer stops: the client gets a truncated document.
+  auto open(char c) -> JsonWriter & {
+    if (depth_ + 1 >= EXPRESS_JSON_MAX_DEPTH) {
+      LOG_E(F("json nested too deep"));
+      failed_ = true;
+    }
+    if (!separate())
+      return *this;
+    out_.write(c);
+    depth_++;
+    hasValue_ &= ~(uint32_t(1) << depth_);
+    return *this;
+  }
+
+  auto close(char c) -> JsonWriter & {
+    if (failed_)
+      return *this;
+    out_.write(c);
+    if (depth_ > 0)
+      depth_--;
+    return *this;
+  }
+
+  /// @brief the digits of an integer of up to 64 bits
+  auto integer(unsigned long long magnitude, const bool negative) -> void {
+    char digits[21];
+    auto p = digits + sizeof(digits);
+    do {
+      *--p = '0' + magnitude % 10;
+      magnitude /= 10;
+    } while (magnitude > 0);
+    if (negative)
+      *--p = '-';
+
+    if (separate())
+      out_.write(reinterpret_cast<const uint8_t *>(p),
+                 digits + sizeof(digits) - p);
+  }
+
+  /// @brief a formatted number
+  auto literal(const char *formatted) -> JsonWriter & {
+    if (separate())
+      out_.write(reinterpret_cast<const uint8_t *>(formatted),
+                 strlen(formatted));
+    return *this;
+  }
+
+  /// @brief quoted and escaped (RFC 8259)
+  auto string(const char *str, size_t length) -> void {
+    static const char hex[] PROGMEM = "0123456789abcdef";
+
+    out_.write('"');
+
+    // runs of characters that need no escaping are written at once
+    size_t run = 0;
+    for (size_t i = 0; i < length; i++) {
+      const auto c = static_cast<uint8_t>(str[i]);
+      if (c >= 0x20 && c != '"' && c != '\\')
+        continue;
+
+      out_.write(reinterpret_cast<const uint8_t *>(str + run), i - run);
+      run = i + 1;
+
+      out_.write('\\');
+      switch (c) {
+      case '"':
+      case '\\':
+        out_.write(c);
+        break;
+      case '\b':
+        out_.write('b');
+        break;
+      case '\f':
+        out_.write('f');
+        break;
+      case '\n':
+        out_.write('n');
+        break;
+      case '\r':
+        out_.write('r');
+        break;
+      case '\t':
+        out_.write('t');
+        break;
+      default:
+        out_.write('u');
+        out_.write('0');
+        out_.write('0');
+        out_.write(hex[c >> 4]);
+        out_.write(hex[c & 0xF]);
+      }
+    }
+    out_.write(reinterpret_cast<const uint8_t *>(str + run), length - run);
+
+    out_.write('"');
+  }
+
+public:
+  JsonWriter(Print &out) : out_(out) {}
+
+  /// @brief Nested deeper than EXPRESS_JSON_MAX_DEPTH, the document was cut
+  /// off there
+  auto failed() const -> bool { return failed_; }
+
+  /// @brief
+  auto beginObject() -> JsonWriter & { return open('{'); }
+
+  /// @brief
+  auto endObject() -> JsonWriter & { return close('}'); }
+
+  /// @brief
+  auto beginArray() -> JsonWriter & { return open('['); }
+
+  /// @brief
+  auto endArray() -> JsonWriter & { return close(']'); }
+
+  /// @brief Member name, the value (or object, array) follows
+  auto key(const char *name, size_t length) -> JsonWriter & {
+    if (!separate())
+      return *this;
+    string(name, length);
+    out_.write(':');
+    afterKey_ = true;
+    return *this;
+  }
+
+  /// @brief
+  auto key(const char *name) -> JsonWriter & {
+    return key(name, strlen(name));
+  }
+
+  /// @brief
+  auto key(const String &name) -> JsonWriter & {
+    return key(name.c_str(), name.length());
+  }
+
+  /// @brief F("name"): the ESP32 maps flash into the address space
+  auto key(const __FlashStringHelper *name) -> JsonWriter & {
+    return key(reinterpret_cast<const char *>(name));
+  }
+
+  /// @brief
+  auto value(const char *str, size_t length) -> JsonWriter & {
+    if (separate())
+      string(str, length);
+    return *this;
+  }
+
+  /// @brief
+  auto value(const char *str) -> JsonWriter & {
+    if (nullptr == str)
+      return null();
+    return value(str, strlen(str));
+  }
+
+  /// @brief
+  auto value(const String &str) -> JsonWriter & {
+    return value(str.c_str(), str.length());
+  }
+
+  /// @brief F("text"), without it a flash string would become a bool
+  auto value(const __FlashStringHelper *str) -> JsonWriter & {
+    return value(reinterpret_cast<const char *>(str));
+  }
+
+  /// @brief
+  auto value(bool b) -> JsonWriter & {
+    if (separate())
+      out_.print(b ? F("true") : F("false"));
+    return *this;
+  }
+
+  /// @brief
+  auto value(int number) -> JsonWriter & { return value(long(number)); }
+
+  /// @brief
+  auto value(unsigned int number) -> JsonWriter & {
+    return value((unsigned long)number);
+  }
+
+  /// @brief
+  auto value(long number) -> JsonWriter & { return value((long long)number); }
+
+  /// @brief
+  auto value(unsigned long number) -> JsonWriter & {
+    return value((unsigned long long)number);
+  }
+
+  /// @brief also int64_t
+  auto value(long long number) -> JsonWriter & {
+    integer(number < 0 ? 0ULL - (unsigned long long)number : number,
+            number < 0);
+    return *this;
+  }
+
+  /// @brief also uint64_t
+  auto value(unsigned long long number) -> JsonWriter & {
+    integer(number, false);
+    return *this;
+  }
+
+  /// @brief The shortest form (15 or 17 significant digits) that reads back
+  /// as the same double. NaN and infinity have no JSON representation, they
+  /// become null.
+  auto value(double number) -> JsonWriter & {
+    if (isnan(number) || isinf(number))
+      return null();
+
+    char formatted[32];
+    snprintf(formatted, sizeof(formatted), "%.15g", number);
+    if (strtod(formatted, nullptr) != number)
+      snprintf(formatted, sizeof(formatted), "%.17g", number);
+    return literal(formatted);
+  }
+
+  /// @brief As a float (6 or 9 significant digits), so 0.1f is 0.1
+  auto value(float number) -> JsonWriter & {
+    if (isnan(number) || isinf(number))
+      return null();
+
+    char formatted[32];
+    snprintf(formatted, sizeof(formatted), "%.6g", double(number));
+    if (strtof(formatted, nullptr) != number)
+      snprintf(formatted, sizeof(formatted), "%.9g", double(number));
+    return literal(formatted);
+  }
+
+  /// @brief With a fixed number of decimals (at most 15), eg for readings
+  /// with a known precision. Very large numbers are written as value(number).
+  auto value(double number, int decimals) -> JsonWriter & {
+    if (isnan(number) || isinf(number))
+      return null();
+    if (fabs(number) >= 1e15)
+      return value(number);
+
+    if (decimals < 0)
+      decimals = 0;
+    if (decimals > 15)
+      decimals = 15;
+
+    char formatted[40];
+    snprintf(formatted, sizeof(formatted), "%.*f", decimals, number);
+    return literal(formatted);
+  }
+
+  /// @brief A value that is already JSON (not escaped)
+  auto raw(const char *json, size_t length) -> JsonWriter & {
+    if (separate())
+      out_.write(reinterpret_cast<const uint8_t *>(json), length);
+    return *this;
+  }
+
+  /// @brief
+  auto null() -> JsonWriter & {
+    if (separate())
+      out_.print(F("null"));
+    return *this;
+  }
+};
@@ -0,0 +1,261 @@
+#ifndef EXPRESS_OUTPUT_BUFFER_SIZE
+/// @brief Size of the per connection output buffer. Default is one TCP
+/// segment on Ethernet (MSS), so a small response goes out in one packet.
+#define EXPRESS_OUTPUT_BUFFER_SIZE 1460
+#endif
+
+#ifndef EXPRESS_FILE_CHUNK_SIZE
+/// @brief Files are read in pieces of this size when they can not be read into
+/// the output buffer directly (compressed responses). Taken from the stack.
+#define EXPRESS_FILE_CHUNK_SIZE 512
+#endif
+
+#ifdef EXPRESS_USE_WRITEV
+// Note: only for clients on top of an lwIP socket (WiFiClient)
+#include <errno.h>
+#include <sys/uio.h>
+#endif
+
+/// @brief Collects everything that is written for a response (status line,
+/// headers, body) and hands it to the client in as few writes as possible.
+/// Every client write can become its own SPI transaction (W5500) or TCP
+/// segment (lwIP).
+class OutputBuffer : public Print {
+private:
+  ClientType &client_;
+
+  byte buffer_[EXPRESS_OUTPUT_BUFFER_SIZE];
+  size_t length_ = 0;
+
+  /// @brief total number of bytes handed to the client
+  size_t sent_ = 0;
+
+  /// @brief Transfer-Encoding: chunked. Each flush of the buffer is one chunk,
+  /// room for the chunk size is reserved in front of the data.
+  bool chunked_ = false;
+  size_t chunkStart_ = 0;
+
+  /// @brief "XXXX\r\n", fixed width (leading zeros are allowed)
+  static constexpr size_t chunkHeader = 6;
+  /// @brief "\r\n"
+  static constexpr size_t chunkTrailer = 2;
+
+  /// @brief receives a copy of everything handed to the client
+  Print *tap_ = nullptr;
+
+  static_assert(EXPRESS_OUTPUT_BUFFER_SIZE <= 0xFFFF,
+                "the chunk size must fit in 4 hex digits");
+
+  /// @brief
+  auto send(const byte *data, size_t size) -> void {
+    client_.write(data, size);
+    sent_ += size;
+    if (tap_)
+      tap_->write(data, size);
+  }
+
+  auto flushRaw() -> void {
+    if (length_ == 0)
+      return;
+
+    send(buffer_, length_);
+    length_ = 0;
+  }
+
+  /// @brief reserves room for the size of the next chunk
+  auto openChunk() -> void {
+    if (length_ + chunkHeader + chunkTrailer >= sizeof(buffer_))
+      flushRaw();
+    chunkStart_ = length_;
+    length_ += chunkHeader;
+  }
+
+  /// @brief fills in the size of the current chunk, or drops it when empty
+  auto closeChunk() -> void {
+    const auto size = length_ - chunkStart_ - chunkHeader;
+    if (size == 0) {
+      length_ = chunkStart_;
+      return;
+    }
+
+    static const char hex[] PROGMEM = "0123456789ABCDEF";
+    auto header = buffer_ + chunkStart_;
+    header[0] = hex[(size >> 12) & 0xF];
+    header[1] = hex[(size >> 8) & 0xF];
+    header[2] = hex[(size >> 4) & 0xF];
+    header[3] = hex[size & 0xF];
+    header[4] = '\r';
+    header[5] = '\n';
+
+    buffer_[length_++] = '\r';
+    buffer_[length_++] = '\n';
+  }
+
+  /// @brief
+  auto capacity() const -> size_t {
+    return chunked_ ? sizeof(buffer_) - chunkTrailer : sizeof(buffer_);
+  }
+
+#ifdef EXPRESS_USE_WRITEV
+  /// @brief buffered bytes and data in one (scatter-gather) send
+  auto writev(const byte *data, size_t size) -> void {
+    if (tap_) {
+      tap_->write(buffer_, length_);
+      tap_->write(data, size);
+    }
+
+    struct iovec iov[2] = {{buffer_, length_}, {(void *)data, size}};
+    int iovcnt = 2;
+    struct iovec *current = iov;
+    int tries = 1000;
+
+    while (iovcnt > 0 && tries > 0) {
+      auto n = ::writev(client_.fd(), current, iovcnt);
+      if (n < 0) {
+        if (errno != EAGAIN)
+          break;
+        tries--;
+        delay(1);
+        continue;
+      }
+
+      sent_ += n;
+      while (iovcnt > 0 && static_cast<size_t>(n) >= current->iov_len) {
+        n -= current->iov_len;
+        current++;
+        iovcnt--;
+      }
+      if (iovcnt > 0) {
+        current->iov_base = static_cast<byte *>(current->iov_base) + n;
+        current->iov_len -= n;
+      }
+    }
+
+    length_ = 0;
+  }
+#endif
+
+public:
+  OutputBuffer(ClientType &client) : client_(client) {}
+
+  /// @brief
+  size_t write(uint8_t c) override {
+    if (length_ == capacity())
+      flush();
+    buffer_[length_++] = c;
+    return 1;
+  }
+
+  /// @brief Small writes are buffered, large ones go straight to the client
+  /// (after what is buffered). Chunks are always sent from the buffer, so
+  /// their size is bounded by the buffer size.
+  size_t write(const uint8_t *data, size_t size) override {
+    if (length_ + size <= capacity()) {
+      memcpy(buffer_ + length_, data, size);
+      length_ += size;
+      return size;
+    }
+
+    if (chunked_) {
+      auto remaining = size;
+      while (remaining > 0) {
+        if (length_ == capacity())
+          flush();
+        const auto n = std::min(remaining, capacity() - length_);
+        memcpy(buffer_ + length_, data, n);
+        length_ += n;
+        data += n;
+        remaining -= n;
+      }
+      return size;
+    }
+
+#ifdef EXPRESS_USE_WRITEV
+    writev(data, size);
+#else
+    // top up the buffer, so the client gets full segments
+    const auto fill = sizeof(buffer_) - length_;
+    memcpy(buffer_ + length_, data, fill);
+    length_ += fill;
+    flush();
+
+    const auto remaining = size - fill;
+    if (remaining >= sizeof(buffer_))
+      send(data + fill, remaining);
+    else {
+      memcpy(buffer_, data + fill, remaining);
+      length_ = remaining;
+    }
+#endif
+
+    return size;
+  }
+
+  using Print::write;
+
+  /// @brief Reads (up to) size bytes from the stream straight into the buffer,
+  /// no intermediate copy. The buffer is handed to the client whenever full.
+  /// @return number of bytes read
+  auto writeFrom(Stream &in, size_t size) -> size_t {
+    size_t total = 0;
+    while (size > 0) {
+      if (length_ == capacity())
+        flush();
+
+      const auto n = in.readBytes(reinterpret_cast<char *>(buffer_ + length_),
+                                  std::min(size, capacity() - length_));
+      if (n == 0)
+        break;
+
+      length_ += n;
+      size -= n;
+      total += n;
+    }
+    return total;
+  }
+
+  /// @brief Hands the buffered bytes to the client
+  void flush() override {
+    if (chunked_) {
+      closeChunk();
+      flushRaw();
+      openChunk();
+    } else
+      flushRaw();
+  }
+
+  /// @brief Everything written from here on is sent as chunks
+  auto beginChunked() -> void {
+    if (chunked_)
+      return;
+    chunked_ = true;
+    openChunk();
+  }
+
+  /// @brief Sends the last chunk and the (empty) trailer
+  auto endChunked() -> void {
+    if (!chunked_)
+      return;
+    closeChunk();
+    chunked_ = false;
+    write(reinterpret_cast<const uint8_t *>("0\r\n\r\n"), 5);
+    flushRaw();
+  }
+
+  /// @brief Hands what is buffered, then data, to the client: data in a
+  /// single write, not copied into the buffer.
+  auto writeThrough(const byte *data, size_t size) -> void {
+    flush();
+    send(data, size);
+  }
+
+  /// @brief From here on, a copy of every byte handed to the client is
+  /// written to copy (nullptr to stop)
+  auto tap(Print *copy) -> void { tap_ = copy; }
+
+  /// @brief
+  auto chunked() const -> bool { return chunked_; }
+
+  /// @brief number of bytes handed to the client so far
+  auto sent() const -> size_t { return sent_; }
+};
@@ -1,5 +1,8 @@
 #include "Express.h"
 
+#include <algorithm>
+#include <climits>
+
 BEGIN_EXPRESS_NAMESPACE
 
 ///
@@ -64,4 +67,115 @@ const Range &_Request::rangeParse(const String &str, const size_t &maxSize) {
   return *range_;
 }
 
+/// @brief
+/// @param str
+/// @param number
+/// @return false when str is not a (non-negative) number. A number too
+/// large for a long is LONG_MAX: beyond the end of anything that is sent.
+static auto parseNumber(const String &str, long &number) -> bool {
+  if (str.length() == 0)
+    return false;
+
+  number = 0;
+  for (size_t i = 0; i < str.length(); i++) {
+    if (!isdigit(str[i]))
+      return false;
+    const auto digit = str[i] - '0';
+    number = (number > (LONG_MAX - digit) / 10) ? LONG_MAX
+                                                 : number * 10 + digit;
+  }
+
+  return true;
+}
+
+///
+auto Range::resolve(const String &header, const size_t size) -> int {
+  ranges.clear();
+
+  auto index = header.indexOf('=');
+  if (index < 0)
+    return -2;
+
+  type = header.substring(0, index);
+  type.trim();
+  if (!type.equalsIgnoreCase(F("bytes")))
+    return -2;
+
+  // a set without any range in it is malformed, not unsatisfiable
+  auto specified = false;
+
+  int start = index + 1;
+  while (start < (int)header.length()) {
+    auto end = header.indexOf(',', start);
+    if (end < 0)
+      end = header.length();
+
+    auto item = header.substring(start, end);
+    start = end + 1;
+
+    item.trim();
+    if (item.length() == 0)
+      continue;
+
+    auto dash = item.indexOf('-');
+    if (dash < 0)
+      return -2;
+
+    auto first = item.substring(0, dash);
+    auto last = item.substring(dash + 1);
+    first.trim();
+    last.trim();
+
+    long begin, finish;
+    specified = true;
+    if (first.length() == 0) {
+      // suffix: the last n bytes
+      if (!parseNumber(last, finish))
+        return -2;
+      if (finish == 0)
+        continue;
+      begin = ((size_t)finish >= size) ? 0 : size - finish;
+      finish = size - 1;
+    } else {
+      if (!parseNumber(first, begin))
+        return -2;
+      if (last.length() == 0)
+        finish = size - 1;
+      else if (!parseNumber(last, finish) || finish < begin)
+        return -2;
+      else if ((size_t)finish >= size)
+        finish = size - 1;
+    }
+
+    if ((size_t)begin >= size)
+      continue;
+
+    ranges.push_back({(int)begin, (int)finish});
+  }
+
+  if (!specified)
+    return -2;
+  return ranges.empty() ? -1 : (int)ranges.size();
+}
+
+///
+auto Range::combine() -> void {
+  if (ranges.size() < 2)
+    return;
+
+  std::sort(ranges.begin(), ranges.end(),
+            [](const beginEnd &a, const beginEnd &b) {
+              return a.start < b.start;
+            });
+
+  size_t last = 0;
+  for (size_t i = 1; i < ranges.size(); i++) {
+    if (ranges[i].start <= ranges[last].end + 1)
+      ranges[last].end = std::max(ranges[last].end, ranges[i].end);
+    else
+      ranges[++last] = ranges[i];
+  }
+  ranges.resize(last + 1);
+}
+
 END_EXPRESS_NAMESPACE
@@ -0,0 +1,142 @@
+#include "base64.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+static const char alphabet[] PROGMEM =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+// value of every character, 0x80: padding or whitespace, 0xff: invalid
+#define X 0xff
+#define S 0x80
+static const uint8_t values[256] PROGMEM = {
+    X,  X,  X,  X,  X,  X,  X,  X,  X,  S,  S,  X,  X,  S,  X,  X,  //
+    X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  //
+    S,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  62, X,  X,  X,  63, //
+    52, 53, 54, 55, 56, 57, 58, 59, 60, 61, X,  X,  X,  S,  X,  X,  //
+    X,  0,  1,  2,  3,  4,  5,  6,  7,  8,  9,  10, 11, 12, 13, 14, //
+    15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, X,  X,  X,  X,  X,  //
+    X,  26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, //
+    41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, X,  X,  X,  X,  X,  //
+    X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  //
+    X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  //
+    X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  //
+    X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  //
+    X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  //
+    X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  //
+    X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  //
+    X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  X,  //
+};
+#undef X
+#undef S
+
+/// @brief
+size_t Base64::encode(const uint8_t *data, const size_t length, char *out) {
+  auto o = out;
+  size_t i = 0;
+
+  // 3 bytes in, 4 characters out, stored as one word
+  for (; i + 3 <= length; i += 3) {
+    const uint32_t v = (data[i] << 16) | (data[i + 1] << 8) | data[i + 2];
+    const char group[4] = {alphabet[v >> 18], alphabet[(v >> 12) & 0x3f],
+                           alphabet[(v >> 6) & 0x3f], alphabet[v & 0x3f]};
+    memcpy(o, group, 4);
+    o += 4;
+  }
+
+  if (i < length) {
+    uint32_t v = data[i] << 16;
+    if (i + 1 < length)
+      v |= data[i + 1] << 8;
+
+    *o++ = alphabet[v >> 18];
+    *o++ = alphabet[(v >> 12) & 0x3f];
+    *o++ = (i + 1 < length) ? alphabet[(v >> 6) & 0x3f] : '=';
+    *o++ = '=';
+  }
+
+  return o - out;
+}
+
+/// @brief
+String Base64::encode(const String &data) {
+  const auto length = encodedLength(data.length());
+  char *buffer = new char[length];
+
+  encode(reinterpret_cast<const uint8_t *>(data.c_str()), data.length(),
+         buffer);
+
+  String str;
+  str.concat(buffer, length);
+  delete[] buffer;
+
+  return str;
+}
+
+/// @brief
+int Base64::decode(const char *text, const size_t length, uint8_t *out,
+                   const size_t capacity) {
+  auto t = reinterpret_cast<const uint8_t *>(text);
+  size_t o = 0;
+  size_t i = 0;
+
+  // fast path: whole groups of 4 valid characters, one check per group
+  while (i + 4 <= length) {
+    const uint32_t a = values[t[i]], b = values[t[i + 1]],
+                   c = values[t[i + 2]], d = values[t[i + 3]];
+    if ((a | b | c | d) & 0x80)
+      break; // padding, whitespace or invalid: slow path
+    if (o + 3 > capacity)
+      return -1;
+
+    const uint32_t v = (a << 18) | (b << 12) | (c << 6) | d;
+    out[o++] = v >> 16;
+    out[o++] = v >> 8;
+    out[o++] = v;
+    i += 4;
+  }
+
+  // slow path: character by character
+  uint32_t v = 0;
+  uint8_t n = 0;
+  auto padding = false;
+  for (; i < length; i++) {
+    const auto value = values[t[i]];
+    if (value == 0xff)
+      return -1;
+    if (value == 0x80) {
+      // '=' ends the data, whitespace is skipped
+      if (t[i] == '=')
+        padding = true;
+      continue;
+    }
+    if (padding)
+      return -1;
+
+    v = (v << 6) | value;
+    if (++n == 4) {
+      if (o + 3 > capacity)
+        return -1;
+      out[o++] = v >> 16;
+      out[o++] = v >> 8;
+      out[o++] = v;
+      v = 0;
+      n = 0;
+    }
+  }
+
+  // 2 characters: 1 byte, 3 characters: 2 bytes
+  if (n == 1)
+    return -1;
+  if (n > 1) {
+    if (o + n - 1 > capacity)
+      return -1;
+    v <<= 6 * (4 - n);
+    out[o++] = v >> 16;
+    if (n == 3)
+      out[o++] = v >> 8;
+  }
+
+  return o;
+}
+
+END_EXPRESS_NAMESPACE
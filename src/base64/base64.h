@@ -0,0 +1,52 @@
+#pragma once
+
+#include <Arduino.h>
+
+#include "../namespace.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+/// @brief Base64 (RFC 4648) codec. Table driven, a group of 3 bytes / 4
+/// characters is handled as one 32-bit word. Decoding writes straight into a
+/// caller-provided buffer.
+class Base64 {
+public:
+  /// @brief
+  /// @param length number of bytes
+  /// @return number of characters, with padding (no terminating zero)
+  static constexpr size_t encodedLength(const size_t length) {
+    return (length + 2) / 3 * 4;
+  }
+
+  /// @brief
+  /// @param length number of characters
+  /// @return upper bound for the number of bytes
+  static constexpr size_t decodedLength(const size_t length) {
+    return (length + 3) / 4 * 3;
+  }
+
+  /// @brief
+  /// @param data
+  /// @param length
+  /// @param out room for encodedLength(length) characters
+  /// @return number of characters written
+  static size_t encode(const uint8_t *data, const size_t length, char *out);
+
+  /// @brief
+  /// @param data
+  /// @return
+  static String encode(const String &data);
+
+  /// @brief Decodes text, padding is optional and whitespace (line breaks)
+  /// is skipped.
+  /// @param text
+  /// @param length
+  /// @param out
+  /// @param capacity size of out, decodedLength(length) is always enough
+  /// @return number of bytes written, -1 when text is not base64 or out is
+  /// too small
+  static int decode(const char *text, const size_t length, uint8_t *out,
+                    const size_t capacity);
+};
+
+END_EXPRESS_NAMESPACE
@@ -0,0 +1,325 @@
+#include "deflate.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+// RFC 1951 3.2.5, length codes 257..285 and distance codes 0..29
+static const uint16_t lengthBase[] PROGMEM = {
+    3,  4,  5,  6,  7,  8,  9,  10, 11,  13,  15,  17,  19,  23, 27,
+    31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtra[] PROGMEM = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1,
+                                              1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+                                              4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distanceBase[] PROGMEM = {
+    1,    2,    3,    4,    5,    7,     9,     13,    17,  25,
+    33,   49,   65,   97,   129,  193,   257,   385,   513, 769,
+    1025, 1537, 2049, 3073, 4097, 6145,  8193,  12289, 16385, 24577};
+static const uint8_t distanceExtra[] PROGMEM = {
+    0, 0, 0, 0, 1, 1, 2, 2,  3,  3,  4,  4,  5,  5,  6,
+    6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+// CRC-32 (gzip), 4 bits at a time: a 64 byte table instead of 1 KB
+static const uint32_t crcTable[] PROGMEM = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4,
+    0x4DB26158, 0x5005713C, 0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C};
+
+/// @brief
+/// @param out
+/// @param format
+Deflate::Deflate(Print &out, const Format format) : out_(out), format_(format) {
+  memset(head_, 0, sizeof(head_));
+
+  if (format_ == Format::Gzip) {
+    // magic, deflate, no flags, no mtime, no extra flags, unknown OS
+    static const uint8_t header[] PROGMEM = {0x1f, 0x8b, 8, 0,   0,
+                                             0,    0,    0, 0, 0xff};
+    out_.write(header, sizeof(header));
+  } else {
+    // deflate, 32K window, no dictionary, check bits
+    static const uint8_t header[] PROGMEM = {0x78, 0x01};
+    out_.write(header, sizeof(header));
+  }
+}
+
+/// @brief least significant bit first
+auto Deflate::putBits(uint32_t value, uint8_t count) -> void {
+  bits_ |= value << bitCount_;
+  bitCount_ += count;
+  while (bitCount_ >= 8) {
+    out_.write(static_cast<uint8_t>(bits_));
+    bits_ >>= 8;
+    bitCount_ -= 8;
+  }
+}
+
+/// @brief Huffman codes are packed most significant bit first
+auto Deflate::putCode(uint16_t code, uint8_t length) -> void {
+  uint16_t reversed = 0;
+  for (uint8_t i = 0; i < length; i++) {
+    reversed = (reversed << 1) | (code & 1);
+    code >>= 1;
+  }
+  putBits(reversed, length);
+}
+
+/// @brief fixed literal/length code (RFC 1951 3.2.6)
+auto Deflate::putLiteral(uint16_t symbol) -> void {
+  if (symbol < 144)
+    putCode(0x30 + symbol, 8);
+  else if (symbol < 256)
+    putCode(0x190 + symbol - 144, 9);
+  else if (symbol < 280)
+    putCode(symbol - 256, 7);
+  else
+    putCode(0xc0 + symbol - 280, 8);
+}
+
+/// @brief index into lengthBase
+auto Deflate::lengthCode(size_t length) -> uint8_t {
+  uint8_t i = sizeof(lengthBase) / sizeof(*lengthBase) - 1;
+  while (lengthBase[i] > length)
+    i--;
+  return i;
+}
+
+/// @brief index into distanceBase
+auto Deflate::distanceCode(size_t distance) -> uint8_t {
+  uint8_t j = sizeof(distanceBase) / sizeof(*distanceBase) - 1;
+  while (distanceBase[j] > distance)
+    j--;
+  return j;
+}
+
+/// @brief
+auto Deflate::matchBits(size_t length, size_t distance) -> uint32_t {
+  const auto i = lengthCode(length);
+  return (257 + i < 280 ? 7 : 8) + lengthExtra[i] + 5 +
+         distanceExtra[distanceCode(distance)];
+}
+
+/// @brief
+auto Deflate::putMatch(size_t length, size_t distance) -> void {
+  const auto i = lengthCode(length);
+  putLiteral(257 + i);
+  putBits(length - lengthBase[i], lengthExtra[i]);
+
+  const auto j = distanceCode(distance);
+  putCode(j, 5);
+  putBits(distance - distanceBase[j], distanceExtra[j]);
+}
+
+/// @brief
+/// @param from position of the first byte of the block
+/// @param bits size of the block in fixed Huffman codes
+auto Deflate::block(size_t from, uint32_t bits) -> void {
+  const auto length = pos_ - from;
+  // header, padding to a byte, LEN and NLEN, the data
+  const uint32_t stored = 3 + (8 - (bitCount_ + 3) % 8) % 8 + 32 + 8 * length;
+
+  if (bits <= stored) {
+    putBits(0, 1);
+    putBits(1, 2);
+    for (size_t i = 0; i < tokenCount_; i++) {
+      const auto &token = tokens_[i];
+      if (token.distance)
+        putMatch(token.length, token.distance);
+      else
+        putLiteral(token.length);
+    }
+    putLiteral(256);
+  } else {
+    putBits(0, 1);
+    putBits(0, 2);
+    if (bitCount_ > 0)
+      putBits(0, 8 - bitCount_);
+    putBits(length, 16);
+    putBits(~length & 0xffff, 16);
+    out_.write(input_ + from, length);
+  }
+
+  tokenCount_ = 0;
+}
+
+/// @brief of the 3 bytes at position
+auto Deflate::hash(size_t position) const -> size_t {
+  const uint32_t v = input_[position] | (input_[position + 1] << 8) |
+                     (input_[position + 2] << 16);
+  return (v * 2654435761u) >> (32 - hashBits);
+}
+
+/// @brief
+auto Deflate::insert(size_t position) -> void {
+  if (position + minMatch > fill_)
+    return;
+
+  const auto h = hash(position);
+  prev_[position] = head_[h];
+  head_[h] = position + 1;
+}
+
+/// @brief Greedy matching: the longest match at each position, trying
+/// EXPRESS_DEFLATE_CHAIN earlier positions with the same hash.
+auto Deflate::compress() -> void {
+  // block header and end of block code
+  static constexpr uint32_t blockBits = 3 + 7;
+  auto from = pos_;
+  auto bits = blockBits;
+
+  while (pos_ < fill_) {
+    size_t bestLength = 0;
+    size_t bestDistance = 0;
+
+    if (fill_ - pos_ >= minMatch) {
+      const auto limit = std::min(maxMatch, fill_ - pos_);
+
+      auto candidate = head_[hash(pos_)];
+      for (auto chain = EXPRESS_DEFLATE_CHAIN; candidate && chain > 0;
+           chain--) {
+        const size_t start = candidate - 1;
+        const auto distance = pos_ - start;
+        if (distance > window)
+          break;
+
+        // cheap reject: the byte that would make this match longer
+        if (input_[start + bestLength] == input_[pos_ + bestLength]) {
+          size_t length = 0;
+          while (length < limit &&
+                 input_[start + length] == input_[pos_ + length])
+            length++;
+
+          if (length > bestLength) {
+            bestLength = length;
+            bestDistance = distance;
+            if (length == limit)
+              break;
+          }
+        }
+
+        candidate = prev_[start];
+      }
+    }
+
+    if (bestLength >= minMatch) {
+      tokens_[tokenCount_++] = {uint16_t(bestLength), uint16_t(bestDistance)};
+      bits += matchBits(bestLength, bestDistance);
+      for (size_t i = 0; i < bestLength; i++)
+        insert(pos_ + i);
+      pos_ += bestLength;
+    } else {
+      tokens_[tokenCount_++] = {input_[pos_], 0};
+      bits += (input_[pos_] < 144) ? 8 : 9;
+      insert(pos_);
+      pos_++;
+    }
+
+    if (tokenCount_ == window) {
+      block(from, bits);
+      from = pos_;
+      bits = blockBits;
+    }
+  }
+
+  if (tokenCount_ > 0)
+    block(from, bits);
+}
+
+/// @brief
+auto Deflate::slide() -> void {
+  memmove(input_, input_ + window, window);
+  fill_ -= window;
+  pos_ -= window;
+
+  for (auto &position : head_)
+    position = (position > window) ? position - window : 0;
+
+  for (size_t i = 0; i < window; i++) {
+    const auto position = prev_[i + window];
+    prev_[i] = (position > window) ? position - window : 0;
+  }
+}
+
+/// @brief
+auto Deflate::checksum(const uint8_t *data, size_t size) -> void {
+  size_ += size;
+
+  if (format_ == Format::Gzip) {
+    auto crc = ~crc_;
+    while (size--) {
+      crc ^= *data++;
+      crc = (crc >> 4) ^ crcTable[crc & 0xf];
+      crc = (crc >> 4) ^ crcTable[crc & 0xf];
+    }
+    crc_ = ~crc;
+  } else {
+    uint32_t a = adler_ & 0xffff;
+    uint32_t b = adler_ >> 16;
+    while (size > 0) {
+      // largest n for which b cannot overflow before the modulo
+      auto n = std::min(size, size_t(5552));
+      size -= n;
+      while (n--) {
+        a += *data++;
+        b += a;
+      }
+      a %= 65521;
+      b %= 65521;
+    }
+    adler_ = (b << 16) | a;
+  }
+}
+
+/// @brief
+size_t Deflate::write(uint8_t c) { return write(&c, 1); }
+
+/// @brief
+size_t Deflate::write(const uint8_t *data, size_t size) {
+  if (finished_)
+    return 0;
+
+  checksum(data, size);
+
+  const auto written = size;
+  while (size > 0) {
+    const auto n = std::min(size, sizeof(input_) - fill_);
+    memcpy(input_ + fill_, data, n);
+    fill_ += n;
+    data += n;
+    size -= n;
+
+    if (fill_ == sizeof(input_)) {
+      compress();
+      slide();
+    }
+  }
+
+  return written;
+}
+
+/// @brief
+auto Deflate::finish() -> void {
+  if (finished_)
+    return;
+  finished_ = true;
+
+  compress();
+
+  // the blocks are not final, end with an empty final block
+  putBits(1, 1);
+  putBits(1, 2);
+  putLiteral(256);
+
+  if (bitCount_ > 0)
+    putBits(0, 8 - bitCount_);
+
+  if (format_ == Format::Gzip) {
+    for (auto i = 0; i < 32; i += 8)
+      out_.write(static_cast<uint8_t>(crc_ >> i));
+    for (auto i = 0; i < 32; i += 8)
+      out_.write(static_cast<uint8_t>(size_ >> i));
+  } else {
+    for (auto i = 24; i >= 0; i -= 8)
+      out_.write(static_cast<uint8_t>(adler_ >> i));
+  }
+}
+
+END_EXPRESS_NAMESPACE
@@ -0,0 +1,112 @@
+#pragma once
+
+#include "../defs.h"
+
+/// @brief Size of the history (in bytes) that matches can refer back to. The
+/// encoder holds twice the window, plus a hash table, match chains and the
+/// codes of one block: about 12 * window bytes (12 KB for the default).
+/// Power of two, max 16384.
+#ifndef EXPRESS_DEFLATE_WINDOW
+#define EXPRESS_DEFLATE_WINDOW 1024
+#endif
+
+/// @brief Number of earlier positions that are tried for a match. Higher
+/// compresses better, at the cost of CPU time.
+#ifndef EXPRESS_DEFLATE_CHAIN
+#define EXPRESS_DEFLATE_CHAIN 8
+#endif
+
+BEGIN_EXPRESS_NAMESPACE
+
+/// @brief Streaming deflate (RFC 1951) encoder: LZ77 over a small sliding
+/// window, fixed Huffman codes. A block that would not get smaller is stored
+/// as is instead. Everything written is compressed into the
+/// downstream Print, in gzip (RFC 1952) or zlib (RFC 1950, HTTP "deflate")
+/// format. Memory use is fixed, independent of the size of the body.
+class Deflate : public Print {
+public:
+  enum class Format { Gzip, Zlib };
+
+private:
+  static constexpr size_t window = EXPRESS_DEFLATE_WINDOW;
+  static constexpr size_t hashBits = 10;
+  static constexpr size_t hashSize = 1 << hashBits;
+  static constexpr size_t minMatch = 3;
+  static constexpr size_t maxMatch = 258;
+
+  static_assert(window >= 256 && window <= 16384 &&
+                    (window & (window - 1)) == 0,
+                "the deflate window must be a power of two, max 16384");
+
+  Print &out_;
+  const Format format_;
+
+  /// @brief history (first half) and new data
+  uint8_t input_[2 * window];
+  size_t fill_ = 0;
+  size_t pos_ = 0;
+
+  /// @brief most recent position (+1) with the hash, 0 is empty
+  uint16_t head_[hashSize];
+  /// @brief previous position (+1) with the same hash as this one
+  uint16_t prev_[2 * window];
+
+  /// @brief literal (distance 0) or match, of the block being encoded
+  struct Token {
+    uint16_t length;
+    uint16_t distance;
+  };
+  Token tokens_[window];
+  size_t tokenCount_ = 0;
+
+  uint32_t bits_ = 0;
+  uint8_t bitCount_ = 0;
+
+  uint32_t crc_ = 0;
+  uint32_t adler_ = 1;
+  uint32_t size_ = 0;
+
+  bool finished_ = false;
+
+  auto putBits(uint32_t value, uint8_t count) -> void;
+  auto putCode(uint16_t code, uint8_t length) -> void;
+  auto putLiteral(uint16_t symbol) -> void;
+  auto putMatch(size_t length, size_t distance) -> void;
+
+  static auto lengthCode(size_t length) -> uint8_t;
+  static auto distanceCode(size_t distance) -> uint8_t;
+  /// @brief size of the codes of a match
+  static auto matchBits(size_t length, size_t distance) -> uint32_t;
+
+  /// @brief Writes the data from..pos_ as one block: the tokens in fixed
+  /// Huffman codes, or the data stored when that is smaller
+  auto block(size_t from, uint32_t bits) -> void;
+
+  auto hash(size_t position) const -> size_t;
+  auto insert(size_t position) -> void;
+
+  /// @brief Encodes the buffered data up to fill_
+  auto compress() -> void;
+
+  /// @brief Drops the oldest window of data, to make room
+  auto slide() -> void;
+
+  auto checksum(const uint8_t *data, size_t size) -> void;
+
+public:
+  Deflate(Print &out, const Format format);
+
+  /// @brief
+  size_t write(uint8_t c) override;
+
+  /// @brief
+  size_t write(const uint8_t *data, size_t size) override;
+
+  using Print::write;
+
+  /// @brief Compresses what is left and writes the end of the stream
+  /// (last block, checksum). Nothing can be written afterwards.
+  auto finish() -> void;
+};
+
+END_EXPRESS_NAMESPACE
@@ -69,10 +69,16 @@ typedef uint8_t byte;
 #error "Alternative for std::vector and std::map here"
 #endif
 
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
 typedef std::map<String, String> locals_t;
 typedef std::map<String, String> params_t;
 
 #include "namespace.h"
+#include "utility/inlineFunction.h"
+#include "base64/base64.h"
 
 BEGIN_EXPRESS_NAMESPACE
 
@@ -97,10 +103,101 @@ using WriteCallback = void (*)(const char *, int);
 struct File {
   String filename;
   ContentCallback contentsCallback;
-  size_t length() { return strlen(contentsCallback()); }
+
+  /// @brief Size of the contents in bytes, known at compile time (eg
+  /// sizeof(data) - 1). With a size the contents can be binary (contain
+  /// zeros). 0: unknown, the contents are a C string.
+  size_t size = 0;
+
+  /// @brief Mime type, nullptr: derived from the file name
+  const char *type = nullptr;
+
+  /// @brief Hash of the contents (for the ETag), 0: computed on first use
+  /// and kept here
+  mutable uint32_t hash = 0;
+
+  /// @brief Time of the last modification (Last-Modified), 0: unknown
+  time_t mtime = 0;
+
+  /// @brief
+  size_t length() const { return size ? size : strlen(contentsCallback()); }
+
+  /// @brief Optional pre-compressed (binary) variants of the contents, served
+  /// instead when the client accepts the encoding
+  const uint8_t *gzip = nullptr;
+  size_t gzipLength = 0;
+  const uint8_t *br = nullptr;
+  size_t brLength = 0;
+
+  /// @brief Hashes of the pre-compressed variants (for their ETags), 0:
+  /// computed on first use and kept here
+  mutable uint32_t gzipHash = 0;
+  mutable uint32_t brHash = 0;
+};
+
+/// @brief An embedded file whose metadata is known at compile time: a
+/// literal type, so a table of them is constexpr and stays in flash. Tables
+/// are generated from a directory by extras/bundle.py.
+struct Asset {
+  /// @brief eg "/index.html"
+  const char *path;
+  ContentCallback contents;
+  size_t size;
+  const char *type;
+  uint32_t hash;
+  time_t mtime;
+  const uint8_t *gzip;
+  size_t gzipLength;
+  uint32_t gzipHash;
+
+  /// @brief As a File, for res.sendFile
+  auto file() const -> File {
+    File file{path, contents};
+    file.size = size;
+    file.type = type;
+    file.hash = hash;
+    file.mtime = mtime;
+    file.gzip = gzip;
+    file.gzipLength = gzipLength;
+    file.gzipHash = gzipHash;
+    return file;
+  }
+};
+
+/// @brief A table of Assets, sorted by path (byte order)
+struct Assets {
+  const Asset *assets;
+  size_t count;
+
+  /// @brief Binary search, nothing is hashed or copied
+  /// @return the asset of a path, nullptr when there is none
+  auto find(const char *path, const size_t length) const -> const Asset * {
+    size_t low = 0;
+    size_t high = count;
+    while (low < high) {
+      const auto mid = (low + high) / 2;
+      const auto candidate = assets[mid].path;
+      auto order = strncmp(candidate, path, length);
+      if (order == 0 && candidate[length] != '\0')
+        order = 1;
+      if (order == 0)
+        return &assets[mid];
+      if (order < 0)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+    return nullptr;
+  }
+
+  auto find(const String &path) const -> const Asset * {
+    return find(path.c_str(), path.length());
+  }
 };
 
 #include "Buffer.hpp"
+#include "OutputBuffer.hpp"
+#include "JsonWriter.hpp"
 
 /// @brief When std::vector's are not available, an
 /// alternative implementation uses fixed length containers.
@@ -115,6 +212,19 @@ struct beginEnd {
 struct Range {
   String type;
   std::vector<beginEnd> ranges;
+
+  /// @brief Resolves a Range header (eg "bytes=0-99,200-,-50") against the
+  /// size of the resource: open and suffix ranges are made absolute, ends
+  /// are clamped to the size and unsatisfiable ranges are dropped.
+  /// @param header
+  /// @param size
+  /// @return the number of ranges, -1 when none is satisfiable, -2 when the
+  /// header is malformed (or not in bytes)
+  auto resolve(const String &header, const size_t size) -> int;
+
+  /// @brief Sorts the ranges and merges the ones that overlap or are adjacent
+  auto combine() -> void;
+
   String toString() {
     String str(type);
     str += F("=");
@@ -124,12 +234,62 @@ struct Range {
       str += end;
       str += F(",");
     }
-    str[str.length() - 1] = '\0';
+    str.remove(str.length() - 1);
 
     return str;
   }
 };
 
+#ifndef EXPRESS_ACCEPT_MAX_RANGES
+/// @brief Media ranges kept from an Accept header, the ones with the highest
+/// quality win when there are more.
+#define EXPRESS_ACCEPT_MAX_RANGES 8
+#endif
+
+/// @brief An Accept header, parsed once into media ranges sorted by quality
+/// (the order of the header for equal quality). Types known to MimeType are
+/// kept as their id, others as their span of the header.
+struct Accept {
+  /// @brief MimeType id, or one of:
+  static constexpr int16_t Any = -1;        // */*
+  static constexpr int16_t AnySubtype = -2; // type/*
+  static constexpr int16_t Unknown = -3;    // not in the MimeType table
+
+  struct MediaRange {
+    int16_t type;
+    /// @brief span of header: the type (AnySubtype) or the full MIME type
+    /// (Unknown)
+    uint16_t offset;
+    uint16_t length;
+    /// @brief quality, 0..1000
+    uint16_t q;
+  };
+
+  MediaRange ranges[EXPRESS_ACCEPT_MAX_RANGES];
+  uint8_t count = 0;
+
+  /// @brief the header that was parsed
+  String header;
+
+  /// @brief
+  /// @param header
+  auto parse(const String &header) -> void;
+
+  /// @brief Picks the best of the offered types: highest quality, then most
+  /// specific media range, then the order of the Accept header, then the
+  /// order of the offer. Without media ranges (no Accept header) the first
+  /// type is the best.
+  /// @param types MIME types (text/html) or extensions (html)
+  /// @param count
+  /// @return the index of the type, -1 when none is acceptable
+  auto best(const String *types, const size_t count) const -> int;
+
+  /// @brief The span of the range is (case insensitive) the length first
+  /// characters of type
+  auto matches(const MediaRange &range, const char *type,
+               const size_t length) const -> bool;
+};
+
 class Options {
 public:
   /// Object containing HTTP headers to serve with the file.
@@ -144,15 +304,21 @@ public:
   /// making conditional requests during the life of the maxAge option to
   /// check if the file has changed.
   bool immutable = false;
+  /// Cache a file with a hash of its contents in the name (see fingerprinted)
+  /// for a year, immutable, when maxAge is not set. Only enable this when
+  /// such names really change with the contents.
+  bool fingerprints = false;
   /// Option for serving dotfiles. Possible values are “allow”, “deny”,
   /// “ignore”.
   String dotfiles = F("ignore");
-  /// Sets the max-age property of the Cache-Control header in milliseconds or
-  /// a string in ms format
-  int maxAge = 0;
+  /// Sets the max-age property of the Cache-Control header in milliseconds,
+  /// at most a year is sent
+  uint64_t maxAge = 0;
   /// Sets the max-age property of the Cache-Control header in milliseconds or
   /// a string in ms format
   String root{};
+  /// File served for a directory (static middleware), empty to disable.
+  String index = F("index.html");
 
   /// @brief Default constructor
   Options() {}
@@ -163,10 +329,76 @@ public:
     this->acceptRanges = another->acceptRanges;
     this->cacheControl = another->cacheControl;
     this->immutable = another->immutable;
+    this->fingerprints = another->fingerprints;
     this->dotfiles = another->dotfiles;
     this->maxAge = another->maxAge;
     this->root = another->root;
+    this->index = another->index;
+    this->cacheControl_ = another->cacheControl_;
+  }
+
+  /// @brief The Cache-Control header value for a file, from cacheControl,
+  /// maxAge and immutable. It is rendered once, so set these before the first
+  /// file is sent. With fingerprints, a fingerprinted file gets cached for a
+  /// year, immutable, unless maxAge is set.
+  /// @param filename
+  /// @return empty when no header is to be sent
+  auto cacheControlFor(const String &filename) -> const String & {
+    static const String none{};
+    static const String forever{F("public, max-age=31536000, immutable")};
+
+    if (!cacheControl)
+      return none;
+
+    if (fingerprints && maxAge == 0 && fingerprinted(filename))
+      return forever;
+
+    if (cacheControl_.length() == 0) {
+      // like express (send), max-age is capped at a year
+      const uint64_t year = 31536000;
+      cacheControl_ = F("public, max-age=");
+      cacheControl_ += String(uint32_t(std::min(maxAge / 1000, year)));
+      if (immutable)
+        cacheControl_ += F(", immutable");
+    }
+
+    return cacheControl_;
   }
+
+  /// @brief A file name with a hash of the contents in it (at least 8 hex
+  /// digits between '.', '-' or '_', eg app.3f9a2b1c.js or logo-5d41402a.png)
+  /// changes whenever the contents change.
+  /// @param filename
+  /// @return
+  static auto fingerprinted(const String &filename) -> bool {
+    size_t run = 0;
+    auto digit = false;
+    auto delimited = false;
+
+    for (size_t i = filename.lastIndexOf('/') + 1; i < filename.length(); i++) {
+      const auto c = filename[i];
+      if (c == '.' || c == '-' || c == '_') {
+        if (delimited && run >= 8 && digit)
+          return true;
+        delimited = true;
+        run = 0;
+        digit = false;
+      } else if (isxdigit(c)) {
+        run++;
+        digit |= isdigit(c);
+      } else {
+        // not a hash, wait for the next delimiter
+        delimited = false;
+        run = 0;
+      }
+    }
+
+    return false;
+  }
+
+private:
+  /// @brief pre-rendered Cache-Control value
+  String cacheControl_{};
 };
 
 struct PosLen {
@@ -174,6 +406,74 @@ struct PosLen {
   size_t len;
 };
 
+/// @brief SameSite attribute of a cookie
+enum class SameSite { Unset, Strict, Lax, None };
+
+/// @brief Attributes of a cookie set with res.cookie()
+struct CookieOptions {
+  /// @brief Domain name for the cookie. Defaults to the domain name of the app.
+  String domain{};
+  /// @brief Path for the cookie.
+  String path = F("/");
+  /// @brief Expiry relative to the current time in milliseconds, 0 for a
+  /// session cookie.
+  long maxAge = 0;
+  /// @brief Expiry date (UTC), 0 for a session cookie.
+  time_t expires = 0;
+  /// @brief Flags the cookie to be accessible only by the web server.
+  bool httpOnly = false;
+  /// @brief Marks the cookie to be used with HTTPS only.
+  bool secure = false;
+  /// @brief
+  SameSite sameSite = SameSite::Unset;
+
+  /// @brief Writes the attributes ("; Path=/; HttpOnly"), as they appear
+  /// after the value in Set-Cookie.
+  auto printTo(Print &) const -> void;
+};
+
+/// @brief The cookies of a request. The Cookie header is only parsed on first
+/// access, into spans (offset, length) of the name and value: nothing is
+/// copied until a value is asked for as a String.
+class Cookies {
+private:
+  const std::map<String, String> &headers_;
+  const char *header_ = nullptr;
+  std::vector<std::pair<PosLen, PosLen>> spans_;
+  bool parsed_ = false;
+
+  auto parse() -> void;
+  auto indexOf(const char *name, const size_t length) -> int;
+
+public:
+  explicit Cookies(const std::map<String, String> &headers)
+      : headers_(headers) {}
+
+  /// @brief number of cookies
+  auto size() -> size_t;
+
+  /// @brief
+  auto has(const String &name) -> bool;
+
+  /// @brief Value of a cookie, without quotes and percent-decoded.
+  /// @return empty when there is no such cookie
+  auto get(const String &name) -> String;
+
+  /// @brief
+  auto operator[](const String &name) -> String { return get(name); }
+
+  /// @brief Value of a cookie, as is (no copy). Valid for the lifetime of the
+  /// request.
+  /// @param name
+  /// @param value
+  /// @param length
+  /// @return false when there is no such cookie
+  auto find(const char *name, const char *&value, size_t &length) -> bool;
+
+  /// @brief name of the i-th cookie
+  auto name(const size_t i) -> String;
+};
+
 enum Method {
   GET,    // The GET method requests a representation of the specified resource.
           // Requests using GET should only retrieve data.
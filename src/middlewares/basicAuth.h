@@ -1,5 +1,3 @@
-#include <Base64.h>
-
 #include "defs.h"
 
 BEGIN_EXPRESS_NAMESPACE
@@ -7,11 +5,18 @@ BEGIN_EXPRESS_NAMESPACE
 /// @brief inspired by https://github.com/LionC/_Express-basic-auth
 class BasicAuth {
 public:
-  static std::map<String, String> users;
-  static bool challenge;
+  /// @brief base64 of "user:password", encoded once up front
+  std::vector<String> credentials;
+  bool challenge;
 
 public:
-  static auto auth(_Request &req, _Response &res, const NextCallback next)
+  BasicAuth(const std::map<String, String> &users, const bool challenge)
+      : challenge(challenge) {
+    for (auto const &user : users)
+      credentials.push_back(Base64::encode(user.first + ":" + user.second));
+  }
+
+  auto auth(_Request &req, _Response &res, const NextCallback next) const
       -> void {
     auto basicAuth = req.headers["authorization"]; // basic encodeUserPasswd
 
@@ -22,9 +27,8 @@ public:
       basicAuth = basicAuth.substring(6);
       basicAuth.trim();
 
-      for (auto const &user : users) {
-        auto sum = user.first + ":" + user.second;
-        if (base64::encode(sum) == basicAuth) {
+      for (auto const &credential : credentials) {
+        if (credential == basicAuth) {
           authenticated = true;
           break;
         }
@@ -43,17 +47,17 @@ public:
   }
 };
 
-std::map<String, String> BasicAuth::users{};
-bool BasicAuth::challenge = false;
-
 END_EXPRESS_NAMESPACE
 
-/// @brief
+/// @brief Each call creates its own configuration (users, challenge), so
+/// several routes can be protected with different credentials. The
+/// configuration is held by the callback itself.
 /// @return
 static MiddlewareCallback basicAuth(const std::map<String, String> &users,
                                     const bool challenge = true) {
-  BasicAuth::users = users;
-  BasicAuth::challenge = challenge;
+  const BasicAuth config(users, challenge);
 
-  return BasicAuth::auth;
+  return [config](_Request &req, _Response &res, const NextCallback next) {
+    config.auth(req, res, next);
+  };
 }
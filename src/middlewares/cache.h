@@ -0,0 +1,329 @@
+#include "defs.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+/// @brief Keeps complete responses (status line, headers and body, exactly as
+/// they were sent) of GET and HEAD requests, keyed by method and URL. A hit is
+/// written to the client in a single write, the route handlers do not run.
+///
+/// Only 200 responses without cookies, that are not marked no-store or
+/// private, are kept. A response with a Vary header is kept per value of the
+/// request headers it names (eg one entry for gzip, one for identity).
+/// Requests with a Range header bypass the cache. A conditional request
+/// (If-None-Match, If-Modified-Since) that matches the validators of the
+/// entry is answered with 304, without the body.
+///
+/// The entries together stay within a byte budget, the least recently used
+/// ones are evicted to make room. Use invalidate() when the data behind a
+/// route changes, from a handler or the task that runs the app.
+class ResponseCache {
+private:
+  struct Entry {
+    String key;
+    /// @brief the Vary header of the response, and the values of the
+    /// request headers it names
+    String vary;
+    String varyValues;
+    /// @brief validators and caching headers, for a 304
+    String etag;
+    String lastModified;
+    String cacheControl;
+    uint8_t *data = nullptr;
+    size_t length = 0;
+    unsigned long stored = 0;
+    unsigned long ttl = 0;
+    uint32_t lastUsed = 0;
+  };
+
+  /// @brief Collects the bytes of a response, gives up when it does not fit
+  class Capture : public Print {
+  public:
+    ResponseCache &cache;
+    _Request &req;
+    _Response &res;
+    const String key;
+    const unsigned long ttl;
+
+    uint8_t *data = nullptr;
+    size_t length = 0;
+    size_t capacity = 0;
+    bool overflow = false;
+
+    Capture(ResponseCache &cache, _Request &req, _Response &res,
+            const String &key, const unsigned long ttl)
+        : cache(cache), req(req), res(res), key(key), ttl(ttl) {}
+    ~Capture() { free(data); }
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+
+    size_t write(const uint8_t *buffer, size_t size) override {
+      if (overflow)
+        return size;
+
+      if (length + size > capacity) {
+        auto grow = std::max(capacity * 2, length + size);
+        grow = std::min(grow, cache.budget_);
+        if (length + size > grow) {
+          overflow = true;
+          return size;
+        }
+        const auto bigger = static_cast<uint8_t *>(realloc(data, grow));
+        if (nullptr == bigger) {
+          overflow = true;
+          return size;
+        }
+        data = bigger;
+        capacity = grow;
+      }
+
+      memcpy(data + length, buffer, size);
+      length += size;
+      return size;
+    }
+  };
+
+  std::vector<Entry> entries_;
+  const size_t budget_;
+  const unsigned long ttl_;
+  size_t used_ = 0;
+  uint32_t clock_ = 0;
+
+  /// @brief
+  static auto key(_Request &req) -> String {
+    String key = req.method;
+    key += ' ';
+    key += req.uri;
+    auto separator = '?';
+    for (auto const &[name, value] : req.query) {
+      key += separator;
+      key += name;
+      key += '=';
+      key += value;
+      separator = '&';
+    }
+    return key;
+  }
+
+  /// @brief values of the request headers named in vary
+  static auto varyValues(_Request &req, const String &vary) -> String {
+    String values;
+    int start = 0;
+    while (start < (int)vary.length()) {
+      auto end = vary.indexOf(',', start);
+      if (end < 0)
+        end = vary.length();
+      auto field = vary.substring(start, end);
+      field.trim();
+      field.toLowerCase();
+      values += req.get(field);
+      values += '\n';
+      start = end + 1;
+    }
+    return values;
+  }
+
+  auto erase(const size_t i) -> void {
+    used_ -= entries_[i].length;
+    free(entries_[i].data);
+    entries_.erase(entries_.begin() + i);
+  }
+
+  /// @brief evicts the least recently used entries until size bytes fit
+  auto makeRoom(const size_t size) -> void {
+    while (!entries_.empty() && used_ + size > budget_) {
+      size_t lru = 0;
+      for (size_t i = 1; i < entries_.size(); i++)
+        if (entries_[i].lastUsed < entries_[lru].lastUsed)
+          lru = i;
+      erase(lru);
+      evictions++;
+    }
+  }
+
+  /// @brief
+  auto find(_Request &req, const String &key) -> int {
+    for (size_t i = 0; i < entries_.size(); i++) {
+      auto &entry = entries_[i];
+      if (entry.key != key)
+        continue;
+
+      if (entry.ttl && millis() - entry.stored >= entry.ttl) {
+        erase(i);
+        return -1;
+      }
+
+      if (entry.vary.length() > 0 &&
+          varyValues(req, entry.vary) != entry.varyValues)
+        continue;
+
+      return i;
+    }
+    return -1;
+  }
+
+  /// @brief keeps the captured response, when it may be reused
+  auto store(Capture *capture) -> void {
+    auto &req = capture->req;
+    auto &res = capture->res;
+    const auto cacheControl = res.get(F("cache-control"));
+    const auto vary = res.get(F("vary"));
+
+    if (capture->overflow || capture->length == 0 ||
+        res.status_ != HttpStatus::OK || res.hasCookies() ||
+        cacheControl.indexOf(F("no-store")) >= 0 ||
+        cacheControl.indexOf(F("private")) >= 0 || vary == F("*"))
+      return;
+
+    Entry entry;
+    entry.key = capture->key;
+    entry.vary = vary;
+    if (vary.length() > 0)
+      entry.varyValues = varyValues(req, vary);
+    entry.etag = res.get(F("etag"));
+    entry.lastModified = res.get(F("last-modified"));
+    entry.cacheControl = cacheControl;
+
+    // an entry that was stored meanwhile (same key and variant) is replaced
+    const auto existing = find(req, capture->key);
+    if (existing >= 0)
+      erase(existing);
+
+    makeRoom(capture->length);
+
+    // hand over the captured bytes
+    entry.data = static_cast<uint8_t *>(realloc(capture->data, capture->length));
+    if (nullptr == entry.data)
+      entry.data = capture->data;
+    capture->data = nullptr;
+    entry.length = capture->length;
+    entry.stored = millis();
+    entry.ttl = capture->ttl;
+    entry.lastUsed = ++clock_;
+
+    used_ += entry.length;
+    entries_.push_back(entry);
+    stores++;
+  }
+
+public:
+  /// @brief number of requests answered from the cache
+  uint32_t hits = 0;
+  /// @brief number of (cacheable) requests that ran the handlers
+  uint32_t misses = 0;
+  /// @brief bytes written from the cache, instead of being produced again
+  uint64_t bytesSaved = 0;
+  /// @brief
+  uint32_t stores = 0;
+  /// @brief entries removed to stay within the budget
+  uint32_t evictions = 0;
+
+  /// @brief
+  /// @param budget maximum number of bytes kept, for all entries together
+  /// @param ttl default time to live of an entry in ms, 0 is forever
+  ResponseCache(const size_t budget = 8192, const unsigned long ttl = 0)
+      : budget_(budget), ttl_(ttl) {}
+
+  ResponseCache(const ResponseCache &) = delete;
+  ResponseCache &operator=(const ResponseCache &) = delete;
+
+  ~ResponseCache() { clear(); }
+
+  /// @brief Removes the entries of a path (all methods, query strings and
+  /// variants)
+  /// @param path eg "/info"
+  auto invalidate(const String &path) -> void {
+    for (size_t i = entries_.size(); i-- > 0;) {
+      const auto &key = entries_[i].key;
+      const auto start = key.indexOf(' ') + 1;
+      const auto query = key.indexOf('?', start);
+      const auto end = (query < 0) ? key.length() : size_t(query);
+      // "/" is stored as an empty uri
+      const auto stored = key.substring(start, end);
+      if (stored == path || (stored == F("") && path == F("/")))
+        erase(i);
+    }
+  }
+
+  /// @brief Removes all entries
+  auto clear() -> void {
+    for (auto &entry : entries_)
+      free(entry.data);
+    entries_.clear();
+    used_ = 0;
+  }
+
+  /// @brief bytes in use by the entries
+  auto size() const -> size_t { return used_; }
+
+  /// @brief
+  auto count() const -> size_t { return entries_.size(); }
+
+  /// @brief hits / (hits + misses)
+  auto hitRatio() const -> float {
+    return (hits + misses) ? float(hits) / (hits + misses) : 0;
+  }
+
+  /// @brief
+  auto handle(_Request &req, _Response &res, const NextCallback next,
+              const unsigned long ttl) -> void {
+    if ((req.method != F("GET") && req.method != F("HEAD")) ||
+        req.get(F("range")) != F("")) {
+      next(nullptr);
+      return;
+    }
+
+    const auto k = key(req);
+
+    const auto i = find(req, k);
+    if (i >= 0) {
+      auto &entry = entries_[i];
+      entry.lastUsed = ++clock_;
+      hits++;
+      LOG_V(F("cache hit"), k);
+
+      // the client has it already
+      if ((entry.etag != F("") || entry.lastModified != F("")) &&
+          res.notModified(entry.etag, entry.lastModified)) {
+        if (entry.lastModified != F(""))
+          res.set(F("last-modified"), entry.lastModified);
+        if (entry.cacheControl != F(""))
+          res.set(F("cache-control"), entry.cacheControl);
+        if (entry.vary != F(""))
+          res.set(F("vary"), entry.vary);
+        return;
+      }
+
+      bytesSaved += entry.length;
+      res.replay(entry.data, entry.length);
+      return;
+    }
+
+    misses++;
+
+    const auto capture = new Capture(*this, req, res, k, ttl ? ttl : ttl_);
+    res.capture(*capture, [capture]() {
+      capture->cache.store(capture);
+      delete capture;
+    });
+
+    next(nullptr);
+  }
+};
+
+END_EXPRESS_NAMESPACE
+
+/// @brief Answers GET and HEAD requests from the cache when it can, otherwise
+/// runs the following handlers and keeps their response. Several routes can
+/// share one cache (and its budget).
+/// @param responseCache
+/// @param ttl time to live in ms of the entries of these routes, 0 for the
+/// default of the cache
+/// @return
+static MiddlewareCallback cache(ResponseCache &responseCache,
+                                const unsigned long ttl = 0) {
+  const auto store = &responseCache;
+
+  return [store, ttl](_Request &req, _Response &res, const NextCallback next) {
+    store->handle(req, res, next, ttl);
+  };
+}
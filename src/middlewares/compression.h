@@ -0,0 +1,19 @@
+#include "defs.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+/// @brief inspired by https://github.com/expressjs/compression
+/// Compresses the response bodies (gzip or deflate, as the client accepts)
+/// of the routes that follow. Only compressible types (MimeType) are
+/// compressed, and only bodies that are not known to be smaller than
+/// threshold (bytes). The compressor uses a fixed amount of memory, see
+/// EXPRESS_DEFLATE_WINDOW.
+/// @return
+static MiddlewareCallback compression(const size_t threshold = 1024) {
+  return [threshold](_Request &req, _Response &res, const NextCallback next) {
+    res.compress(threshold);
+    next(nullptr);
+  };
+}
+
+END_EXPRESS_NAMESPACE
@@ -1,82 +1,411 @@
-#define LOGGER Serial
-#define LOG_LOGLEVEL LOG_LOGLEVEL_VERBOSE
-
 #include "defs.h"
 
+/// @brief Maximum nesting of sections (and of partials)
+#ifndef EXPRESS_MUSTACHE_DEPTH
+#define EXPRESS_MUSTACHE_DEPTH 8
+#endif
+
+/// @brief Number of compiled templates kept, the least recently used one
+/// makes room
+#ifndef EXPRESS_MUSTACHE_CACHE_SIZE
+#define EXPRESS_MUSTACHE_CACHE_SIZE 8
+#endif
+
 BEGIN_EXPRESS_NAMESPACE
 
-/// @brief
+/// @brief Mustache template engine. A template is compiled on first use into
+/// a list of opcodes: literal spans (into the template itself, nothing is
+/// copied) and variable slots (the key, looked up in the locals). The result
+/// is cached by file name, so rendering is one write per opcode. A name that
+/// comes with other contents (another pointer, or another size) is compiled
+/// again; the contents themselves are not scanned per render.
+///
+/// Sections iterate over rows that are pulled from a callback, passed with
+/// the view (res.render(file, locals, sections)), while the body is sent: a
+/// table is rendered one row at a time, straight to the client, never as a
+/// whole. Without rows, a section is rendered once when its local is set
+/// (and not "", "0" or "false").
 class mustache {
+public:
+  /// @brief Pulls the rows of a section, one at a time
+  /// @param index of the row, 0 first
+  /// @param row locals of the row (shadow the outer ones), empty for every
+  /// row
+  /// @return false when there are no more rows
+  using Rows = RowsCallback;
+
+  /// @brief
+  enum class Kind : uint8_t {
+    /// @brief text, written as it is
+    Literal,
+    /// @brief {{name}}, {{{name}}} or {{&name}}
+    Variable,
+    /// @brief {{#name}}...{{/name}}
+    Section,
+    /// @brief {{^name}}...{{/name}}, rendered when the section would not be
+    Inverted,
+    /// @brief {{> name}}
+    Partial,
+  };
+
+  /// @brief
+  struct Op {
+    Kind kind;
+    /// @brief Variable, Section, Inverted, Partial: index in Template::keys
+    uint16_t slot;
+    /// @brief Literal: span of the template. Section, Inverted: the body is
+    /// the ops up to (not including) offset.
+    uint32_t offset;
+    uint32_t length;
+  };
+
+  /// @brief
+  struct Template {
+    const char *source = nullptr;
+    std::vector<Op> ops;
+    /// @brief names of the variables, sections and partials, one per slot
+    std::vector<String> keys;
+    /// @brief of the contents it was compiled from
+    size_t length = 0;
+    uint32_t lastUsed = 0;
+    /// @brief being rendered (a partial is compiled while its parent renders),
+    /// not to be evicted
+    mutable uint8_t rendering = 0;
+  };
+
 private:
+  /// @brief locals of the enclosing sections, innermost last
+  struct Context {
+    const sections_t *sections;
+    locals_t *frames[EXPRESS_MUSTACHE_DEPTH + 1];
+    size_t depth = 0;
+    size_t partials = 0;
+  };
+
+  /// @brief compiled templates, by file name (or partial name)
+  static auto templates() -> std::map<String, Template *> & {
+    static std::map<String, Template *> templates{};
+    return templates;
+  }
+
   /// @brief
-  /// @return
-  static signed int find(const char *line, const char *ss, const int from,
-                         const int to) {
-    int w = 0;
-    int j = 0;
-    for (auto i = from; i < to; i++) {
-      if (line[i] == ss[j]) {
-        j++;
-        w = i;
-      } else if (w > 0)
-        break; // optimization: stop after equality is found
-    }
+  static auto clock() -> uint32_t & {
+    static uint32_t clock = 0;
+    return clock;
+  }
 
-    return (2 == j) ? w : -1;
+  /// @brief drops the least recently used template that is not rendered
+  static auto evict() -> void {
+    auto &cache = templates();
+    auto lru = cache.end();
+    for (auto it = cache.begin(); it != cache.end(); ++it)
+      if (0 == it->second->rendering &&
+          (lru == cache.end() || it->second->lastUsed < lru->second->lastUsed))
+        lru = it;
+    if (lru == cache.end())
+      return;
+    delete lru->second;
+    cache.erase(lru);
   }
 
   /// @brief
-  static void renderLine(ClientType &client, const char *line, int from,
-                         const int to, locals_t &locals) {
-    while (from < to) {
-      auto index = find(line, "{{", from, to);
-      if (index < 1)
+  static auto partials() -> std::map<String, ContentCallback> & {
+    static std::map<String, ContentCallback> partials{};
+    return partials;
+  }
+
+  /// @brief
+  static auto isSpace(const char c) -> bool {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+  }
+
+  /// @brief
+  static auto literal(Template &compiled, const size_t from, const size_t to)
+      -> void {
+    if (to > from)
+      compiled.ops.push_back(
+          {Kind::Literal, 0, uint32_t(from), uint32_t(to - from)});
+  }
+
+  /// @brief the slot of a key, the same key shares its slot
+  static auto slot(Template &compiled, const char *name, const size_t length)
+      -> uint16_t {
+    for (size_t i = 0; i < compiled.keys.size(); i++) {
+      const auto &key = compiled.keys[i];
+      if (key.length() == length && strncmp(key.c_str(), name, length) == 0)
+        return i;
+    }
+
+    String key;
+    key.reserve(length);
+    for (size_t i = 0; i < length; i++)
+      key += name[i];
+    compiled.keys.push_back(key);
+    return compiled.keys.size() - 1;
+  }
+
+  /// @brief Single pass over the template. A tag that is not closed is
+  /// literal text, a section that is not closed ends with the template.
+  static auto compile(Template &compiled) -> void {
+    const auto source = compiled.source;
+
+    // ops of the open sections
+    std::vector<size_t> open;
+
+    size_t literalStart = 0;
+    size_t i = 0;
+    while (source[i] != '\0') {
+      if (source[i] != '{' || source[i + 1] != '{') {
+        i++;
+        continue;
+      }
+
+      const auto tagStart = i;
+      i += 2;
+
+      auto triple = false;
+      auto type = '\0';
+      if (source[i] == '{') {
+        triple = true;
+        i++;
+      } else if (source[i] != '\0' && strchr("&!#^/>", source[i])) {
+        type = source[i];
+        i++;
+      }
+
+      const auto nameStart = i;
+      while (source[i] != '\0' && !(source[i] == '}' && source[i + 1] == '}'))
+        i++;
+      if (source[i] == '\0')
         break;
 
-      client.write(line + from, index - from - 1);
+      auto nameEnd = i;
+      i += 2;
+      if (triple && source[i] == '}')
+        i++;
 
-      from = index + 1;
+      literal(compiled, literalStart, tagStart);
+      literalStart = i;
 
-      index = find(line, "}}", from, to);
-      if (index < 1)
-        return;
+      if (type == '!')
+        continue;
 
-      char key_[15];
-      strncpy(key_, line + from, index - from - 1);
-      key_[index - from - 1] = '\0';
+      auto from = nameStart;
+      while (from < nameEnd && isSpace(source[from]))
+        from++;
+      while (nameEnd > from && isSpace(source[nameEnd - 1]))
+        nameEnd--;
 
-      client.print(locals[key_]);
+      const auto key = slot(compiled, source + from, nameEnd - from);
 
-      from = index + 1;
-    }
+      if (type == '/') {
+        // closes the innermost section, when the name matches
+        if (open.empty() || compiled.ops[open.back()].slot != key) {
+          LOG_E(F("mustache: unexpected close tag"), compiled.keys[key]);
+          continue;
+        }
+        compiled.ops[open.back()].offset = compiled.ops.size();
+        open.pop_back();
+        continue;
+      }
+
+      if (type == '#' || type == '^')
+        open.push_back(compiled.ops.size());
 
-    if (from < to) {
-      client.write(line + from, to - from);
-      client.write('\n');
+      const auto kind = (type == '#')   ? Kind::Section
+                        : (type == '^') ? Kind::Inverted
+                        : (type == '>') ? Kind::Partial
+                                        : Kind::Variable;
+      compiled.ops.push_back({kind, key, 0, 0});
     }
+
+    while (source[i] != '\0')
+      i++;
+    literal(compiled, literalStart, i);
+    compiled.length = i;
+
+    for (const auto section : open)
+      compiled.ops[section].offset = compiled.ops.size();
+
+    compiled.ops.shrink_to_fit();
+    compiled.keys.shrink_to_fit();
   }
 
 public:
+  /// @brief The compiled template, compiled and cached on first use. Call it
+  /// from setup() to compile the templates before the first request.
+  /// @param name file name the template is cached by
+  /// @param source contents of the template (eg a File's contentsCallback())
+  /// @param length of the contents, 0: unknown
+  static auto compile(const String &name, const char *source,
+                      const size_t length = 0) -> const Template & {
+    auto &cache = templates();
+    const auto it = cache.find(name);
+    Template *compiled;
+    if (it != cache.end()) {
+      compiled = it->second;
+      compiled->lastUsed = ++clock();
+      if (compiled->source == source &&
+          (0 == length || compiled->length == length))
+        return *compiled;
+
+      // the name has other contents now
+      compiled->source = source;
+      compiled->ops.clear();
+      compiled->keys.clear();
+    } else {
+      if (cache.size() >= EXPRESS_MUSTACHE_CACHE_SIZE)
+        evict();
+      compiled = new Template();
+      compiled->source = source;
+      compiled->lastUsed = ++clock();
+      cache[name] = compiled;
+    }
+
+    compile(*compiled);
+
+    LOG_V(F("mustache compiled, ops"), compiled->ops.size());
+
+    return *compiled;
+  }
+
+private:
+  /// @brief the value of a key, in the innermost section that has it
+  static auto lookup(const Context &context, const String &key)
+      -> const String * {
+    for (auto depth = context.depth; depth-- > 0;) {
+      const auto locals = context.frames[depth];
+      const auto it = locals->find(key);
+      if (it != locals->end())
+        return &it->second;
+    }
+    return nullptr;
+  }
+
   /// @brief
-  static void renderFile(ClientType &client, locals_t &locals, Options *options, const char *f) {
-    LOG_V(F("> renderFile"));
+  static auto truthy(const String *value) -> bool {
+    return value && *value != F("") && *value != F("0") &&
+           *value != F("false");
+  }
 
-    size_t i = 0;
-    size_t start = 0;
-    while (f[start + i] != '\0') {
-      while (f[start + i] != '\n' && f[start + i] != '\0')
-        i++;
+  /// @brief renders the ops [from, to)
+  static auto render(Print &client, const Template &compiled, size_t from,
+                     const size_t to, Context &context) -> void {
+    while (from < to) {
+      const auto &op = compiled.ops[from++];
+      if (op.kind == Kind::Literal) {
+        client.write(compiled.source + op.offset, op.length);
+        continue;
+      }
 
-      renderLine(client, f, start, start + i, locals);
+      const auto &key = compiled.keys[op.slot];
+      switch (op.kind) {
+      case Kind::Literal:
+        break;
+
+      case Kind::Variable: {
+        const auto value = lookup(context, key);
+        if (value)
+          client.write(value->c_str(), value->length());
+        break;
+      }
+
+      case Kind::Section:
+      case Kind::Inverted: {
+        const auto body = from;
+        from = op.offset;
+
+        const auto it = context.sections->find(key);
+        if (it == context.sections->end() || !it->second) {
+          if (truthy(lookup(context, key)) == (op.kind == Kind::Section))
+            render(client, compiled, body, op.offset, context);
+          break;
+        }
 
-      if (f[start + i] == '\0')
+        if (context.depth > EXPRESS_MUSTACHE_DEPTH) {
+          LOG_E(F("mustache: sections nested too deep"), key);
+          break;
+        }
+
+        locals_t row;
+        if (op.kind == Kind::Inverted) {
+          if (!it->second(0, row))
+            render(client, compiled, body, op.offset, context);
+          break;
+        }
+
+        // no keys of the previous row are left behind
+        context.frames[context.depth++] = &row;
+        for (size_t index = 0; it->second(index, row); index++) {
+          render(client, compiled, body, op.offset, context);
+          row.clear();
+        }
+        context.depth--;
         break;
+      }
+
+      case Kind::Partial: {
+        const auto it = partials().find(key);
+        if (it == partials().end() || nullptr == it->second)
+          break;
 
-      start += i + 1;
-      i = 0;
+        if (context.partials >= EXPRESS_MUSTACHE_DEPTH) {
+          LOG_E(F("mustache: partials nested too deep"), key);
+          break;
+        }
+
+        const auto &partial = compile(key, it->second());
+        context.partials++;
+        partial.rendering++;
+        render(client, partial, 0, partial.ops.size(), context);
+        partial.rendering--;
+        context.partials--;
+        break;
+      }
+      }
     }
+  }
+
+public:
+  /// @brief Registers a template that is included with {{> name}}, rendered
+  /// with the locals where it is included
+  /// @param name
+  /// @param contents eg the contentsCallback of a File
+  static auto partial(const String &name, const ContentCallback contents)
+      -> void {
+    partials()[name] = contents;
+  }
+
+  /// @brief Drops the compiled templates
+  static auto clear() -> void {
+    for (auto &[name, compiled] : templates())
+      delete compiled;
+    templates().clear();
+  }
 
-    LOG_V(F("< renderFile"));
+  /// @brief
+  /// @param client
+  /// @param compiled
+  /// @param locals
+  /// @param sections rows by section name: {{#name}} renders its body once
+  /// per row, {{^name}} only when there are none
+  static auto render(Print &client, const Template &compiled,
+                     locals_t &locals, const sections_t &sections = {})
+      -> void {
+    Context context;
+    context.sections = &sections;
+    context.frames[context.depth++] = &locals;
+    compiled.rendering++;
+    render(client, compiled, 0, compiled.ops.size(), context);
+    compiled.rendering--;
+  }
+
+  /// @brief
+  static void renderFile(Print &client, locals_t &locals,
+                         const sections_t &sections, Options *options,
+                         const File &view) {
+    render(client, compile(view.filename, view.contentsCallback(), view.size),
+           locals, sections);
   }
 };
 
@@ -1,5 +1,9 @@
 #include "mimeType.h"
 
+#include <algorithm>
+#include <ctype.h>
+#include <stdint.h>
+
 const char *MimeType::getType(const char *extension) {
     const char *dot = strrchr(extension, '.');
     if (dot) {
@@ -43,27 +47,107 @@ const char *MimeType::getExtension(const char *type, int skip) {
     return NULL;
 }
 
-// https://www.geeksforgeeks.org/write-your-own-strcmp-which-ignores-cases/
-int MimeType::strcmpi(const char *s1, const char *s2) {
-    int i;
+bool MimeType::compressible(const char *type) {
+    // the type without parameters (text/html; charset=utf-8)
+    const char *end = strchr(type, ';');
+    size_t length = end ? end - type : strlen(type);
+    while (length > 0 && type[length - 1] == ' ') {
+        length--;
+    }
+
+    if (length > 5 && strncasecmp(type, "text/", 5) == 0) {
+        return true;
+    }
+
+    // structured syntax suffixes (image/svg+xml, application/ld+json, ...)
+    static const char *const suffixes[] = {"+json", "+xml", "+yaml"};
+    for (auto suffix : suffixes) {
+        const size_t suffixLength = strlen(suffix);
+        if (length > suffixLength &&
+            strncasecmp(type + length - suffixLength, suffix, suffixLength) == 0) {
+            return true;
+        }
+    }
+
+    static const char *const types[] = {
+        "application/json", "application/json5", "application/hjson",
+        "application/xml", "application/xml-dtd", "application/javascript",
+        "application/x-javascript", "application/ecmascript",
+        "application/yaml", "application/x-yaml", "application/wasm",
+        "image/bmp", "image/x-icon", "image/vnd.microsoft.icon",
+        "font/ttf", "font/otf",
+    };
+    for (auto compressibleType : types) {
+        if (strlen(compressibleType) == length &&
+            strncasecmp(type, compressibleType, length) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+int MimeType::id(const char *type, size_t length) {
+    constexpr size_t count = sizeof(types) / sizeof(*types);
 
-    for (i = 0; s1[i] && s2[i]; ++i) {
-        if (s1[i] == s2[i] || (s1[i] ^ 32) == s2[i]) {
-            continue;
+    // indices of the table, ordered by MIME type. Built on first use.
+    static const uint16_t *byType = [] {
+        static uint16_t index[count];
+        for (size_t i = 0; i < count; i++) {
+            index[i] = i;
+        }
+        std::stable_sort(index, index + count, [](uint16_t a, uint16_t b) {
+            return strcmpi(types[a].mimeType, types[b].mimeType) < 0;
+        });
+        return index;
+    }();
+
+    // first of the equal types, so every spelling maps to the same id
+    int min = 0;
+    int max = count;
+    while (min < max) {
+        int i = (min + max) / 2;
+        if (strncmpi(type, length, types[byType[i]].mimeType) > 0) {
+            min = i + 1;
         } else {
-            break;
+            max = i;
         }
     }
 
-    if (s1[i] == s2[i]) {
-        return 0;
+    if (min < (int)count &&
+        strncmpi(type, length, types[byType[min]].mimeType) == 0) {
+        return byType[min];
     }
 
-    if ((s1[i] | 32) < (s2[i] | 32)) {
-        return -1;
+    return -1;
+}
+
+/// compares the first length characters of s1 (not terminated) with s2
+int MimeType::strncmpi(const char *s1, size_t length, const char *s2) {
+    for (size_t i = 0; i < length; i++) {
+        if (s2[i] == 0) {
+            return 1;
+        }
+        int c1 = tolower(uint8_t(s1[i])), c2 = tolower(uint8_t(s2[i]));
+        if (c1 != c2) {
+            return c1 < c2 ? -1 : 1;
+        }
     }
 
-    return 1;
+    return s2[length] == 0 ? 0 : -1;
+}
+
+/// compares s1 and s2, folded to lower case like strncmpi
+int MimeType::strcmpi(const char *s1, const char *s2) {
+    for (size_t i = 0;; i++) {
+        int c1 = tolower(uint8_t(s1[i])), c2 = tolower(uint8_t(s2[i]));
+        if (c1 != c2) {
+            return c1 < c2 ? -1 : 1;
+        }
+        if (c1 == 0) {
+            return 0;
+        }
+    }
 }
 
 // Source: https://raw.githubusercontent.com/broofa/node-mime/master/types/standard.json
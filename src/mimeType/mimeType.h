@@ -6,6 +6,22 @@ class MimeType {
     static const char* getType(const char* path);
     static const char* getExtension(const char* type, int skip = 0);
 
+    /// @brief Text based types: text/*, a +json, +xml or +yaml suffix (eg
+    /// image/svg+xml) and a list of exact types (application/json, ...).
+    /// Images, audio, video, archives and office documents (zip) are
+    /// compressed already.
+    static bool compressible(const char* type);
+
+    /// @brief Interns a MIME type (case insensitive): the same id for every
+    /// spelling, so types can be compared as integers.
+    /// @return the id, -1 when the type is not in the table
+    static int id(const char* type, size_t length);
+    static int id(const char* type) { return id(type, strlen(type)); }
+
+    /// @brief
+    /// @return the MIME type of an id
+    static const char* name(int id) { return types[id].mimeType; }
+
    private:
     struct entry {
         const char* fileExtension;
@@ -13,6 +29,7 @@ class MimeType {
     };
     static MimeType::entry types[347];
     static int strcmpi(const char* s1, const char* s2);
+    static int strncmpi(const char* s1, size_t length, const char* s2);
 };
 
 inline MimeType mimeType;
\ No newline at end of file
@@ -24,6 +24,7 @@
  */
 
 #include "Express.h"
+#include "mimeType/mimeType.h"
 
 BEGIN_EXPRESS_NAMESPACE
 
@@ -33,17 +34,104 @@ _Request::_Request(_Express &express, ClientType &ec)
   parse(client);
 }
 
+/// @brief Splits a comma separated list, items are trimmed
+static auto splitList(const String &list) -> std::vector<String> {
+  std::vector<String> items;
+
+  int start = 0;
+  while (start < (int)list.length()) {
+    auto end = list.indexOf(',', start);
+    if (end < 0)
+      end = list.length();
+
+    auto item = list.substring(start, end);
+    item.trim();
+    if (item.length() > 0)
+      items.push_back(item);
+
+    start = end + 1;
+  }
+
+  return items;
+}
+
 /// @brief Checks if the specified content types are acceptable, based on the
 /// request’s Accept HTTP header field. The method returns the best match, or if
-/// none of the specified content types is acceptable, returns false (in which
-/// case, the application should respond with 406 "Not Acceptable").
-auto _Request::accepts(const String &types) -> bool { return false; }
+/// none of the specified content types is acceptable, returns an empty string
+/// (in which case, the application should respond with 406 "Not Acceptable").
+auto _Request::accepts(const String &types) -> String {
+  const auto items = splitList(types);
+  const auto index = accepts(items);
+  return index < 0 ? String() : items[index];
+}
+
+/// @brief
+/// @param types
+/// @return
+auto _Request::accepts(const std::vector<String> &types) -> int {
+  if (!acceptParsed_) {
+    accept_.parse(get(F("accept")));
+    acceptParsed_ = true;
+  }
+
+  return accept_.best(types.data(), types.size());
+}
 
 /// @brief Returns the matching content type if the incoming request’s
 /// “Content-Type” HTTP header field matches the MIME type specified by the
-/// type parameter. If the request has no body, returns null. Returns false
+/// type parameter. Returns an empty string if the request has no body, or
 /// otherwise.
-auto _Request::is(const String &types) -> String { return F(""); }
+auto _Request::is(const String &types) -> String {
+  if (get(ContentLength) == F("") && get(F("transfer-encoding")) == F(""))
+    return String();
+
+  auto contentType = get(ContentType);
+  const auto semicolon = contentType.indexOf(';');
+  if (semicolon >= 0)
+    contentType.remove(semicolon);
+  contentType.trim();
+
+  const auto slash = contentType.indexOf('/');
+  if (slash < 0)
+    return String();
+
+  const auto id = MimeType::id(contentType.c_str());
+
+  for (const auto &type : splitList(types)) {
+    if (type == F("*/*"))
+      return type;
+
+    // +json: any type with that suffix
+    if (type[0] == '+') {
+      const auto plus = contentType.lastIndexOf('+');
+      if (plus >= 0 && type.equalsIgnoreCase(contentType.substring(plus)))
+        return type;
+      continue;
+    }
+
+    // text/*
+    if (type.endsWith(F("/*"))) {
+      if (type.length() == size_t(slash + 2) &&
+          type.substring(0, slash).equalsIgnoreCase(
+              contentType.substring(0, slash)))
+        return type;
+      continue;
+    }
+
+    const char *mime = type.c_str();
+    if (type.indexOf('/') < 0) {
+      mime = MimeType::getType(mime); // extension
+      if (nullptr == mime)
+        continue;
+    }
+
+    if (id >= 0 ? id == MimeType::id(mime)
+                : contentType.equalsIgnoreCase(mime))
+      return type;
+  }
+
+  return String();
+}
 
 /// @brief Range header parser.
 /// The size parameter is the maximum size of the resource.
@@ -66,6 +154,42 @@ auto _Request::get(const String &field) -> String {
   return empty;
 }
 
+/// @brief
+/// @param encoding
+/// @return
+auto _Request::acceptsEncodings(const String &encoding) -> bool {
+  const auto &header = get(F("accept-encoding"));
+
+  auto wildcard = false;
+  int start = 0;
+  while (start < (int)header.length()) {
+    auto end = header.indexOf(',', start);
+    if (end < 0)
+      end = header.length();
+
+    auto item = header.substring(start, end);
+    start = end + 1;
+
+    // coding [; q=weight]
+    auto acceptable = true;
+    auto semicolon = item.indexOf(';');
+    if (semicolon >= 0) {
+      auto q = item.indexOf(F("q="), semicolon);
+      if (q >= 0)
+        acceptable = item.substring(q + 2).toFloat() > 0;
+      item.remove(semicolon);
+    }
+    item.trim();
+
+    if (item.equalsIgnoreCase(encoding))
+      return acceptable;
+    if (item == F("*"))
+      wildcard = acceptable;
+  }
+
+  return wildcard;
+}
+
 /// @brief
 /// @param client
 /// @return
@@ -80,6 +204,7 @@ bool _Request::parse(ClientType &client) {
 
   method_ = Method::UNDEFINED;
   uri = "";
+  search = "";
   hostname = "";
   body = "";
   params.clear();
@@ -108,6 +233,7 @@ bool _Request::parse(ClientType &client) {
   auto has_search = url.indexOf('?');
 
   if (has_search != -1) {
+    search = url.substring(has_search);
     search_str = url.substring(has_search + 1);
     url = url.substring(0, has_search);
   }
@@ -24,7 +24,9 @@
  */
 
 #include "Express.h"
+#include "compression/deflate.h"
 #include "mimeType/mimeType.h"
+#include "statusLine/statusLine.h"
 
 BEGIN_EXPRESS_NAMESPACE
 
@@ -32,52 +34,31 @@ BEGIN_EXPRESS_NAMESPACE
 /// @param app
 /// @param client
 /// @return
-_Response::_Response(_Express &_Express, ClientType &client)
-    : app(_Express), client_(client) {
+_Response::_Response(_Express &_Express, _Request &req, ClientType &client)
+    : app(_Express), req(req), client_(client), out_(client), stream_(*this) {
   headersSent = false;
   LOG_T(F("_Response constructor"));
 }
 
+/// @brief
+_Response::~_Response() { delete deflate_; }
+
 /// @brief  // default renderer. Send content in chuncks for x bytes
 /// @param client
 /// @param f
-void _Response::renderFile(ClientType &client, Options *options, const char *f,
-                           const Write_Callback callback) {
+void _Response::renderFile(Print &client, Options *options, const char *f,
+                           const size_t length, const Write_Callback callback) {
   LOG_V(F("default renderer"), (options) ? F("with options.") : F(""));
 
   const size_t maxChunkLen = 2048;
 
-  if (options && options->headers.count(F("range")) > 0) {
-
-    LOG_V(F("range renderFile"));
-
-    auto range = _Request::rangeParse(options->headers[F("range")]);
-
-    auto fileSize = strlen(f);
-
-    for (auto [start, end] : range.ranges) {
-      size_t i = start;
-      while (i < end) {
-        auto remaining =
-            (i + maxChunkLen <= end) ? maxChunkLen : end - i + 1; // size
-        //      LOG_V("write", i, remaining);
-        if (callback)
-          callback(f + i, remaining);
-        client.write(f + i, remaining);
-        i += remaining;
-      }
-    }
-    return;
-  }
-
   size_t i = 0;
-  size_t end = strlen(f);
+  size_t end = length;
 
   LOG_V(F("vanilla renderFile"), i, end);
 
   while (i < end) {
-    auto remaining =
-        (i + maxChunkLen <= end) ? maxChunkLen : end - i + 1; // size
+    auto remaining = (i + maxChunkLen <= end) ? maxChunkLen : end - i; // size
     if (callback)
       callback(f + i, remaining);
     client.write(f + i, remaining);
@@ -91,7 +72,7 @@ void _Response::renderFile(ClientType &client, Options *options, const char *f,
 /// @return
 auto _Response::append(const String &field, const String &value)
     -> _Response & {
-  for (auto [key, header] : headers) {
+  for (auto &[key, header] : headers) {
     if (field.equalsIgnoreCase(key)) {
       // Appends the specified value to the HTTP response header
       header += value;
@@ -105,31 +86,161 @@ auto _Response::append(const String &field, const String &value)
   return *this;
 }
 
+/// @brief Performs content-negotiation on the Accept HTTP header
+/// @param callbacks
+auto _Response::format(const std::vector<std::pair<String, Callback>> &callbacks)
+    -> void {
+  std::vector<String> types;
+  std::vector<const Callback *> handlers;
+  const Callback *fallback = nullptr;
+  for (const auto &callback : callbacks) {
+    if (callback.first == F("default"))
+      fallback = &callback.second;
+    else {
+      types.push_back(callback.first);
+      handlers.push_back(&callback.second);
+    }
+  }
+
+  vary(F("Accept"));
+
+  const auto index = req.accepts(types);
+  if (index < 0) {
+    if (fallback)
+      (*fallback)();
+    else
+      sendStatus(HttpStatus::NONE_ACCEPTABLE);
+    return;
+  }
+
+  const auto &type = types[index];
+  if (type.indexOf('/') >= 0)
+    set(ContentType, type);
+  else if (const auto mime = MimeType::getType(type.c_str()))
+    set(ContentType, mime);
+
+  (*handlers[index])();
+}
+
 /// @brief
+/// @param field
 /// @return
-auto _Response::format() -> void{
-    // TODO
-};
+auto _Response::vary(const String &field) -> _Response & {
+  const auto current = get(F("vary"));
+  if (current == F(""))
+    return set(F("vary"), field);
+
+  // already listed (as a whole item)
+  int start = 0;
+  while (start < (int)current.length()) {
+    auto end = current.indexOf(',', start);
+    if (end < 0)
+      end = current.length();
+    auto item = current.substring(start, end);
+    item.trim();
+    if (item.equalsIgnoreCase(field) || item == F("*"))
+      return *this;
+    start = end + 1;
+  }
+
+  return set(F("vary"), current + F(", ") + field);
+}
 
 /// @brief
 /// @return
 auto _Response::download(File &file) -> void {
   contentsCallback = file.contentsCallback;
+  contentsLength_ = file.size;
   filename = file.filename;
   headers[F("Content-Disposition")] = F("attachment; filename=cool.html");
 };
 
-/// @brief
+/// @brief A cookie name is a token (RFC 6265 4.1.1): no CTLs, spaces or
+/// separators
+static auto isCookieName(const String &name) -> bool {
+  if (name.length() == 0)
+    return false;
+  for (size_t i = 0; i < name.length(); i++) {
+    const uint8_t c = name[i];
+    if (c <= 0x20 || c >= 0x7f || strchr("()<>@,;:\\\"/[]?={}", c))
+      return false;
+  }
+  return true;
+}
+
+/// @brief An attribute value (Domain, Path) has no CTLs and no ';', it can
+/// not end the attribute or the header line
+static auto isCookieAttribute(const String &value) -> bool {
+  for (size_t i = 0; i < value.length(); i++) {
+    const uint8_t c = value[i];
+    if (c < 0x20 || c >= 0x7f || c == ';')
+      return false;
+  }
+  return true;
+}
+
+/// @brief Sets cookie name to value
+/// @param name
+/// @param value
+/// @param options
 /// @return
-auto _Response::cookie() -> void{
-    // TODO
-};
+auto _Response::cookie(const String &name, const String &value,
+                       const CookieOptions &options) -> _Response & {
+  if (!isCookieName(name) || !isCookieAttribute(options.domain) ||
+      !isCookieAttribute(options.path)) {
+    LOG_E(F("invalid cookie, not set:"), name);
+    return *this;
+  }
 
-/// @brief
+  for (auto &cookie : cookies_) {
+    if (cookie.name == name) {
+      cookie.value = value;
+      cookie.options = options;
+      return *this;
+    }
+  }
+
+  cookies_.push_back({name, value, options});
+  return *this;
+}
+
+/// @brief Clears the cookie specified by name: an empty value that expired
+/// long ago.
+/// @param name
+/// @param options
 /// @return
-auto _Response::clearCookie(const String &name) -> void{
-    // TODO
-};
+auto _Response::clearCookie(const String &name, const CookieOptions &options)
+    -> _Response & {
+  CookieOptions expired(options);
+  expired.maxAge = 0;
+  expired.expires = 1;
+
+  return cookie(name, String(), expired);
+}
+
+/// @brief Writes a Set-Cookie header line, the value percent-encoded where
+/// it is not a cookie-octet (RFC 6265 4.1.1)
+/// @param cookie
+auto _Response::printCookie(const SetCookie &cookie) -> void {
+  static const char hex[] PROGMEM = "0123456789ABCDEF";
+
+  out_.print(F("Set-Cookie: "));
+  out_.print(cookie.name);
+  out_.write('=');
+  for (size_t i = 0; i < cookie.value.length(); i++) {
+    const uint8_t c = cookie.value[i];
+    if (c > 0x20 && c < 0x7f && c != '"' && c != ',' && c != ';' &&
+        c != '\\' && c != '%')
+      out_.write(c);
+    else {
+      out_.write('%');
+      out_.write(hex[c >> 4]);
+      out_.write(hex[c & 0xF]);
+    }
+  }
+  cookie.options.printTo(out_);
+  out_.println();
+}
 
 /// @brief Ends the response process. This method actually comes from Node core,
 /// specifically the response.end() method of http.ServerResponse.
@@ -137,15 +248,60 @@ auto _Response::clearCookie(const String &name) -> void{
 /// @param encoding
 /// @return
 auto _Response::end(Buffer *buffer, const String &encoding) -> _Response & {
+  if (streaming_) {
+    if (buffer)
+      write(buffer->buffer + buffer->byteOffset, buffer->length);
+
+    finish();
+
+    return *this;
+  }
+
   if (buffer) {
-    body_ = buffer->toString();
+    rawBuffer_ = *buffer;
+    send(rawBuffer_.data(), rawBuffer_.length);
+  }
+
+  return *this;
+}
+
+/// @brief
+/// @param data
+/// @param length
+/// @return
+auto _Response::write(const uint8_t *data, const size_t length)
+    -> _Response & {
+  if (finished_) {
+    LOG_E(F("write after end"));
+    return *this;
+  }
 
-    LOG_V(body_);
+  if (!streaming_) {
+    streaming_ = true;
+    writeHead();
   }
 
+  if (!suppressBody_)
+    sink().write(data, length);
+
   return *this;
 }
 
+/// @brief
+/// @param data
+/// @param length
+/// @return
+auto _Response::write(const char *data, const size_t length) -> _Response & {
+  return write(reinterpret_cast<const uint8_t *>(data), length);
+}
+
+/// @brief
+/// @param data
+/// @return
+auto _Response::write(const String &data) -> _Response & {
+  return write(data.c_str(), data.length());
+}
+
 /// @brief Returns the HTTP response header specified by field. The match is
 /// case-insensitive.
 /// @return
@@ -169,11 +325,59 @@ auto _Response::json(const String &body) -> void {
   // QUESTION: set content-length here?
 }
 
+/// @brief
+/// @return
+auto _Response::json() -> JsonWriter {
+  if (get(ContentType) == F(""))
+    set(ContentType, ApplicationJson);
+
+  return JsonWriter(stream_);
+}
+
+/// @brief
+/// @return
+auto _Response::stream() -> Print & { return stream_; }
+
+/// @brief
+/// @param c
+/// @return
+size_t _Response::BodyStream::write(uint8_t c) {
+  res_.write(&c, 1);
+  return 1;
+}
+
+/// @brief
+/// @param data
+/// @param length
+/// @return
+size_t _Response::BodyStream::write(const uint8_t *data, size_t length) {
+  res_.write(data, length);
+  return length;
+}
+
 /// @brief Sends the HTTP response.
 /// Optional parameters:
 /// @param view
 auto _Response::send(const String &body) -> _Response & {
   body_ = body;
+  raw_ = nullptr;
+
+  return *this;
+}
+
+/// @brief Sends a binary body. The bytes are not copied: they are written
+/// to the client after the handler returns, so they must stay valid until
+/// then (static, global or heap data).
+/// @param data
+/// @param length
+/// @return
+auto _Response::send(const uint8_t *data, const size_t length) -> _Response & {
+  body_ = String();
+  raw_ = data;
+  rawLength_ = length;
+
+  if (get(ContentType) == F(""))
+    set(ContentType, F("application/octet-stream"));
 
   return *this;
 }
@@ -187,14 +391,18 @@ auto _Response::send(const String &body) -> _Response & {
 ///      internally.
 /// @param file
 /// @param locals
-auto _Response::render(File &file, locals_t &locals) -> void {
+/// @param sections
+auto _Response::render(File &file, locals_t &locals,
+                       const sections_t &sections) -> void {
   // NOTE: don't render here just yet (status and headers need to be send first)
   // so store a backpointer that can be called in the sendBody function.
   // set this here already, so it gets send out as part of the headers
 
   contentsCallback = file.contentsCallback;
   renderLocals = locals; // TODO: check if this copies??
+  renderSections = sections;
   filename = file.filename;
+  contentsLength_ = file.size;
 
   set(ContentType, F("text/html"));
 }
@@ -204,79 +412,443 @@ auto _Response::render(File &file, locals_t &locals) -> void {
  *
  * @param filePath The path of the file to send.
  */
-auto _Response::sendFile(FS &fs, const char *filePath) -> void {
-    fs::File file = fs.open(filePath);
-    if (file) {
-        size_t fileSize = file.size();
+auto _Response::sendFile(FS &fs, const char *filePath, Options *options)
+    -> void {
+  // pre-compressed siblings, in order of preference
+  static const char *const encodings[][2] = {{"br", ".br"}, {"gzip", ".gz"}};
+
+  const String path = filePath;
+  const char *encoding = nullptr;
+  fs::File file;
+
+  for (auto encoded : encodings) {
+    const auto sibling = path + encoded[1];
+    if (!fs.exists(sibling))
+      continue;
+
+    // the response depends on Accept-Encoding, whichever variant is sent
+    vary(F("Accept-Encoding"));
+
+    if (!encoding && req.acceptsEncodings(encoded[0])) {
+      file = fs.open(sibling);
+      if (file)
+        encoding = encoded[0];
+    }
+  }
 
-        // Allocate a buffer with file size + 1
-        char *buffer = new char[fileSize + 1];
+  if (!file)
+    file = fs.open(filePath);
 
-        // Read the file contents directly into the buffer
-        file.readBytes(buffer, fileSize);
+  if (!file) {
+    status(HttpStatus::NOT_FOUND);
+    return;
+  }
 
-        // Close the file
-        file.close();
+  sendOpenFile(file, mimeType.getType(filePath), file.size(), encoding,
+               String(), String(), path, options, false);
+}
 
-        // Set the response headers
-        this->set(ContentType, mimeType.getType(filePath));
-        this->set(ContentLength, String(fileSize+1));
-        status(HttpStatus::OK);
+/// @brief Headers, validators, ranges and the body of an open file. The file
+/// is streamed from the FS when the body is sent.
+/// @param file
+/// @param type of the original (not of the encoding)
+/// @param fileSize
+/// @param encoding of the file (pre-compressed), or nullptr
+/// @param etag empty when there is no validator
+/// @param lastModified
+/// @param path
+/// @param options
+/// @param keepOpen the file is reused (cached), it is not closed
+auto _Response::sendOpenFile(fs::File &file, const char *type,
+                             const size_t fileSize, const char *encoding,
+                             const String &etag, const String &lastModified,
+                             const String &path, Options *options,
+                             const bool keepOpen) -> void {
+  const auto release = [&file, keepOpen]() {
+    if (!keepOpen)
+      file.close();
+  };
+
+  // Set the response headers, the type is the one of the original
+  if (type)
+    this->set(ContentType, type);
+  this->set(ContentLength, String(fileSize));
+  if (encoding)
+    this->set(F("content-encoding"), encoding);
+  if (options)
+    for (auto [key, header] : options->headers)
+      if (!key.equalsIgnoreCase(F("range")))
+        this->set(key, header);
+  cacheControl(path, options);
+  status(HttpStatus::OK);
+
+  if (lastModified != F(""))
+    set(F("last-modified"), lastModified);
+  if (etag != F("") && notModified(etag, lastModified)) {
+    release();
+    return;
+  }
 
-        // Add null terminator at the end of the buffer
-        buffer[fileSize] = '\0';
-        
-        body_ = buffer;
+  // a range of the representation that is sent (compressed or not)
+  if (!options || options->acceptRanges) {
+    set(F("accept-ranges"), F("bytes"));
+
+    // If-Range: only when it matches the validator, otherwise (or without a
+    // validator) the whole file is sent
+    const auto &header = req.get(F("range"));
+    const auto &ifRange = req.get(F("if-range"));
+    const auto current =
+        ifRange == F("") ||
+        (etag != F("") && ifRange == etag) ||
+        (lastModified != F("") && ifRange == lastModified);
+    if (header != F("") && current &&
+        (req.method_ == Method::GET || req.method_ == Method::HEAD)) {
+      Range range;
+      const auto count = range.resolve(header, fileSize);
+      if (count == -1) {
+        status(HttpStatus::RANGE_NOT_SATISFIABLE);
+        set(F("content-range"), String(F("bytes */")) + String(fileSize));
+        removeHeader(ContentLength);
+        removeHeader(ContentType);
+        release();
+        return;
+      }
 
-        delete[] buffer;
-    } else {
-        status(HttpStatus::NOT_FOUND);
+      if (count > 0)
+        byteRanges(range, fileSize);
     }
+  }
+
+  if (suppressBody_) {
+    // HEAD request, no need to read the file
+    release();
+    return;
+  }
+
+  // the file is streamed from the FS when the body is sent
+  file_ = file;
+  fileLength_ = fileSize;
+  keepFile_ = keepOpen;
+}
+
+/// @brief
+/// @param file
+/// @return true when a pre-compressed variant is sent
+auto _Response::sendEncoded(const File &file) -> bool {
+  if (nullptr == file.gzip && nullptr == file.br)
+    return false;
+
+  vary(F("Accept-Encoding"));
+
+  const char *encoding = nullptr;
+  if (file.br && req.acceptsEncodings(F("br"))) {
+    encoding = "br";
+    raw_ = file.br;
+    rawLength_ = file.brLength;
+  } else if (file.gzip && req.acceptsEncodings(F("gzip"))) {
+    encoding = "gzip";
+    raw_ = file.gzip;
+    rawLength_ = file.gzipLength;
+  } else
+    return false;
+
+  set(ContentType,
+      file.type ? file.type : mimeType.getType(file.filename.c_str()));
+  set(F("content-encoding"), encoding);
+  set(ContentLength, String(rawLength_));
+
+  return true;
 }
 
 /// @brief .
 auto _Response::sendFile(const File &file, Options *options) -> void {
+  // A template that is rendered has no length or validator, its output
+  // depends on the locals. The length is taken from the File when it has one,
+  // the contents are scanned at most once.
+  const auto ext = file.filename.substring(file.filename.lastIndexOf('.') + 1);
+  const auto rendered = app.settings[F("view engine")].equals(ext);
+  const size_t fileSize =
+      (file.contentsCallback && !rendered) ? file.length() : 0;
+
+  String lastModified{};
+  if (file.mtime)
+    lastModified = httpDate(file.mtime);
+
+  // validator of the contents as they are (identity)
+  const auto identity = [this, &file, fileSize]() -> String {
+    if (0 == file.hash)
+      file.hash = hash(
+          reinterpret_cast<const uint8_t *>(file.contentsCallback()), fileSize);
+    return etag(fileSize, file.hash);
+  };
+
+  // The range given in the options, or the one of the request (of a 200
+  // response). If-Range: only when it matches the validator, otherwise the
+  // whole file is sent. A range applies to the identity representation.
+  String rangeHeader{};
+  if (options && options->headers.count(F("range")) > 0)
+    rangeHeader = options->headers[F("range")];
+  else if (file.contentsCallback && !rendered && status_ == HttpStatus::OK &&
+           (!options || options->acceptRanges) &&
+           (req.method_ == Method::GET || req.method_ == Method::HEAD)) {
+    const auto &requested = req.get(F("range"));
+    const auto &ifRange = req.get(F("if-range"));
+    if (requested != F("") &&
+        (ifRange == F("") ||
+         (lastModified != F("") && ifRange == lastModified) ||
+         ifRange == identity()))
+      rangeHeader = requested;
+  }
+  const auto ranged = rangeHeader != F("");
+
+  const auto encoded = !ranged && sendEncoded(file);
+  if (encoded && options)
+    for (auto [key, header] : options->headers)
+      this->set(key, header);
+
+  cacheControl(file.filename, options);
+
+  if (lastModified != F(""))
+    set(F("last-modified"), lastModified);
+
+  // validator of the representation that is sent, checked before any body
+  // work
+  if (encoded) {
+    auto &known = (raw_ == file.gzip) ? file.gzipHash : file.brHash;
+    if (0 == known)
+      known = hash(raw_, rawLength_);
+    const auto tag = etag(rawLength_, known, get(F("content-encoding")));
+    if (notModified(tag, lastModified))
+      return;
+  } else if (file.contentsCallback && !rendered) {
+    if (notModified(identity(), lastModified))
+      return;
+  }
+
+  if (encoded)
+    return;
+
   this->contentsCallback = file.contentsCallback;
+  this->contentsLength_ = rendered ? file.size : fileSize;
   this->filename = file.filename;
   if (options)
     this->options = new Options(options);
 
-  if (contentsCallback && options &&
-      options->headers.count(F("range")) > 0) {
-    auto rangeHeader = options->headers[F("range")];
-    auto fileSize = strlen(contentsCallback());
-    auto range = _Request::rangeParse(rangeHeader);
-    size_t sum = 0;
-
-    std::vector<beginEnd> ranges{};
-
-    for (auto [start, end] : range.ranges) {
-      auto cont = (end > fileSize);
-      // check if last range.end is larger than the filesize
-      end = (end > fileSize) ? fileSize - 1 : end;
-      sum += (end - start + 1);
-      ranges.push_back({start, end});
-      if (cont)
-        break;
+  if (contentsCallback && !rendered && get(ContentType) == F("")) {
+    const auto type = file.type ? file.type : mimeType.getType(filename.c_str());
+    if (type)
+      this->set(ContentType, type);
+  }
+
+  if (contentsCallback && ranged && !rendered) {
+    if (options)
+      for (auto [key, header] : options->headers)
+        if (!key.equalsIgnoreCase(F("range")))
+          this->set(key, header);
+
+    Range range;
+    const auto count = range.resolve(rangeHeader, fileSize);
+    if (count == -1) {
+      this->set(F("content-range"), String(F("bytes */")) + String(fileSize));
+      this->status(HttpStatus::RANGE_NOT_SATISFIABLE);
+      contentsCallback = nullptr;
+      return;
+    }
+
+    this->set(F("accept-ranges"), F("bytes"));
+    if (count > 0)
+      byteRanges(range, fileSize);
+    else
+      this->set(ContentLength, String(fileSize));
+
+    LOG_V(F("sendFile range"), rangeHeader, count);
+  } else if (contentsCallback) {
+    if (options)
+      for (auto [key, header] : options->headers)
+        this->set(key, header);
+    if (!rendered) {
+      if (!options || options->acceptRanges)
+        this->set(F("accept-ranges"), F("bytes"));
+      this->set(ContentLength, String(fileSize));
     }
+  }
+}
 
-    range.ranges = ranges;
+/// @brief Makes the response partial content: one range is sent as it is,
+/// several ranges as multipart/byteranges. Overlapping and adjacent ranges are
+/// coalesced first. The part headers are rendered here, so the total length
+/// is known up front.
+/// @param range resolved against size
+/// @param size
+auto _Response::byteRanges(Range &range, const size_t size) -> void {
+  range.combine();
+
+  status(HttpStatus::PARTIAL_CONTENT);
+  parts_ = range.ranges;
+  partHeads_.clear();
+
+  if (parts_.size() == 1) {
+    String contentRange = F("bytes ");
+    contentRange += String(parts_[0].start);
+    contentRange += '-';
+    contentRange += String(parts_[0].end);
+    contentRange += '/';
+    contentRange += String(size);
+
+    set(F("content-range"), contentRange);
+    set(ContentLength, String(parts_[0].end - parts_[0].start + 1));
+    return;
+  }
 
-    this->options->headers[F("range")] = range.toString();
+  String boundary = F("express_");
+  boundary += String((unsigned long)micros(), HEX);
+  boundary += String((unsigned long)random(0x7fffffff), HEX);
 
-    this->set(F("Content-Range"), range.toString() + F("/") + fileSize);
-    this->set(F("Content-Length"), String(sum));
-    this->set(F("Accept-Ranges"), F("bytes"));
-    this->status(HttpStatus::PARTIAL_CONTENT);
+  const auto type = get(ContentType);
 
-    LOG_V(F("sendFile options"), this->options->acceptRanges,
-          this->options->headers[F("range")]);
-  } else if (contentsCallback && options) {
-    for (auto [key, header] : options->headers) {
-      this->set(key, header);
+  size_t length = 0;
+  for (auto [start, end] : parts_) {
+    String head = F("\r\n--");
+    head += boundary;
+    if (type != F("")) {
+      head += F("\r\nContent-Type: ");
+      head += type;
     }
-    this->set(F("Content-Length"), String(strlen(contentsCallback())) );
+    head += F("\r\nContent-Range: bytes ");
+    head += String(start);
+    head += '-';
+    head += String(end);
+    head += '/';
+    head += String(size);
+    head += F("\r\n\r\n");
+
+    length += head.length() + (end - start + 1);
+    partHeads_.push_back(head);
+  }
+
+  String closing = F("\r\n--");
+  closing += boundary;
+  closing += F("--\r\n");
+  length += closing.length();
+  partHeads_.push_back(closing);
+
+  set(ContentType, String(F("multipart/byteranges; boundary=")) + boundary);
+  set(ContentLength, String(length));
+}
+
+/// @brief
+/// @param filename
+/// @param options defaults when nullptr
+auto _Response::cacheControl(const String &filename, Options *options)
+    -> void {
+  static Options defaults{};
+
+  if (get(F("cache-control")) != F(""))
+    return;
+
+  const auto &value = (options ? options : &defaults)->cacheControlFor(filename);
+  if (value.length() > 0)
+    set(F("cache-control"), value);
+}
+
+/// @brief FNV-1a hash of the contents. The contents of a File do not change,
+/// sendFile keeps the hash in the File, so it is computed once per File. Give
+/// the File a hash to skip this.
+/// @param data
+/// @param length
+/// @param seed the hash so far, to hash contents in chunks
+/// @return
+auto _Response::hash(const uint8_t *data, const size_t length,
+                     const uint32_t seed) -> uint32_t {
+  auto hash = seed;
+  for (size_t i = 0; i < length; i++) {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+/// @brief Strong validator: the length and the hash of the contents
+/// @param length
+/// @param hash
+/// @param suffix tells the representations (encodings) apart
+/// @return
+auto _Response::etag(const size_t length, const uint32_t hash,
+                     const String &suffix) -> String {
+  String tag = F("\"");
+  tag += String((unsigned long)length, HEX);
+  tag += '-';
+  tag += String((unsigned long)hash, HEX);
+  if (suffix != F("")) {
+    tag += '-';
+    tag += suffix;
+  }
+  tag += '"';
+
+  return tag;
+}
+
+/// @brief IMF-fixdate, eg "Sun, 06 Nov 1994 08:49:37 GMT"
+/// @param time
+/// @return
+auto _Response::httpDate(const time_t time) -> String {
+  struct tm tm;
+  gmtime_r(&time, &tm);
+
+  char date[32];
+  strftime(date, sizeof(date), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+
+  return String(date);
+}
+
+/// @brief Sets the ETag header and checks it against If-None-Match (weak
+/// comparison), or Last-Modified against If-Modified-Since when there is no
+/// If-None-Match. On a match the response becomes a bodyless 304.
+/// @param etag
+/// @param lastModified
+/// @return true when the client has the current representation
+auto _Response::notModified(const String &etag, const String &lastModified)
+    -> bool {
+  if (etag != F(""))
+    set(F("etag"), etag);
+
+  if (req.method_ != Method::GET && req.method_ != Method::HEAD)
+    return false;
+
+  auto match = false;
+
+  const auto &header = req.get(F("if-none-match"));
+  if (header == F("")) {
+    // the date is one we sent, so it is the same text when unchanged
+    match = lastModified != F("") &&
+            req.get(F("if-modified-since")).equals(lastModified);
   }
+
+  int start = 0;
+  while (!match && start < (int)header.length()) {
+    auto end = header.indexOf(',', start);
+    if (end < 0)
+      end = header.length();
+
+    auto item = header.substring(start, end);
+    start = end + 1;
+
+    item.trim();
+    if (item.startsWith(F("W/")))
+      item.remove(0, 2);
+
+    match = item.equals(etag) || item.equals(F("*"));
+  }
+
+  if (!match)
+    return false;
+
+  status(HttpStatus::NOT_MODIFIED);
+  raw_ = nullptr;
+  removeHeader(ContentLength);
+
+  return true;
 }
 
 /// @brief Sets the response HTTP status code to statusCode and sends the
@@ -285,6 +857,41 @@ auto _Response::sendFile(const File &file, Options *options) -> void {
 /// @param statusCode
 auto _Response::sendStatus(const HttpStatus statusCode) -> void {
   status_ = statusCode;
+
+  // no body allowed
+  if (statusCode < HttpStatus::OK || statusCode == HttpStatus::NO_CONTENT ||
+      statusCode == HttpStatus::NOT_MODIFIED)
+    return;
+
+  size_t length;
+  const auto reason = StatusLine::reason(statusCode, length);
+  if (reason) {
+    body_ = String();
+    body_.concat(reason, length);
+  } else
+    body_ = String(statusCode);
+
+  set(ContentType, F("text/plain"));
+}
+
+/// @brief Removes the HTTP response header field (case-insensitive match)
+/// @param field
+auto _Response::removeHeader(const String &field) -> void {
+  for (auto it = headers.begin(); it != headers.end(); ++it) {
+    if (field.equalsIgnoreCase(it->first)) {
+      headers.erase(it);
+      return;
+    }
+  }
+}
+
+/// @brief
+/// @param threshold
+/// @return
+auto _Response::compress(const size_t threshold) -> _Response & {
+  compressThreshold_ = threshold;
+
+  return *this;
 }
 
 /// @brief Sets the response’s HTTP header field to value
@@ -292,9 +899,9 @@ auto _Response::sendStatus(const HttpStatus statusCode) -> void {
 /// @param value
 /// @return
 auto _Response::set(const String &field, const String &value) -> _Response & {
-  for (auto [key, header] : headers) {
+  for (auto &[key, header] : headers) {
     if (field.equalsIgnoreCase(key)) {
-      // Appends the specified value to the HTTP response header
+      // Replaces the value of the HTTP response header
       header = value;
       return *this;
     }
@@ -316,10 +923,11 @@ auto _Response::status(const HttpStatus status) -> _Response & {
 }
 
 /// @brief
-/// @param client
-void _Response::evaluateHeaders(ClientType &client) {
-  if (body_ && body_ != F(""))
-    headers[ContentLength] = body_.length();
+void _Response::evaluateHeaders() {
+  if (raw_)
+    set(ContentLength, String(rawLength_));
+  else if (body_ && body_ != F(""))
+    set(ContentLength, String(body_.length()));
 
   if (app.settings.count(XPoweredBy) > 0)
     headers[XPoweredBy] = app.settings[XPoweredBy];
@@ -328,13 +936,22 @@ void _Response::evaluateHeaders(ClientType &client) {
 }
 
 /// @brief
-/// @param client
-void _Response::sendBody(ClientType &client, locals_t &locals) {
+/// @param out
+void _Response::sendBody(Print &out, locals_t &locals) {
   LOG_V(F("sendBody"));
 
+  if (suppressBody_)
+    return; // HEAD request, nothing to render
+
   // if we already have a body, send that over
-  if (body_ && body_ != F(""))
-    client.println(body_.c_str());
+  if (raw_)
+    out.write(raw_, rawLength_);
+  else if (file_)
+    sendFileBody(out);
+  else if (body_ && body_ != F(""))
+    out.write(body_.c_str(), body_.length());
+  else if (contentsCallback && !parts_.empty())
+    sendRanges(out, contentsCallback());
   else if (contentsCallback) {
     // a request to generate the body was issued earlier,
     // execute it here.
@@ -346,11 +963,16 @@ void _Response::sendBody(ClientType &client, locals_t &locals) {
     auto engineName = app.settings[F("view engine")];
     if (engineName.equals(ext)) {
       auto engine = app.engines[engineName];
-      if (engine)
-        engine(client, locals, options, contentsCallback());
+      if (engine) {
+        File view{filename, contentsCallback};
+        view.size = contentsLength_;
+        engine(out, locals, renderSections, options, view);
+      }
     } else {
       LOG_V(F("using default renderer"));
-      renderFile(client, options, contentsCallback(),
+      const auto contents = contentsCallback();
+      renderFile(out, options, contents,
+                 contentsLength_ ? contentsLength_ : strlen(contents),
                  [](const char *buffer, const uint &len) {
                    LOG_V(F(""));
                  }); // TODO using callback (so not to send client)
@@ -358,15 +980,65 @@ void _Response::sendBody(ClientType &client, locals_t &locals) {
   }
 }
 
+/// @brief Compression is done when it was asked for (compress()), the client
+/// accepts it, the type is compressible and the body is not known to be small.
+/// Already encoded bodies and partial content are sent as they are.
+/// @return the encoding, or nullptr
+auto _Response::negotiateCompression() -> const char * {
+  if (compressThreshold_ == SIZE_MAX || raw_)
+    return nullptr;
+
+  if (status_ < HttpStatus::OK || status_ == HttpStatus::NO_CONTENT ||
+      status_ == HttpStatus::PARTIAL_CONTENT ||
+      status_ == HttpStatus::NOT_MODIFIED)
+    return nullptr;
+
+  if (get(F("content-encoding")) != F("") ||
+      get(F("cache-control")).indexOf(F("no-transform")) >= 0)
+    return nullptr;
+
+  const auto type = get(ContentType);
+  if (type == F("") || !MimeType::compressible(type.c_str()))
+    return nullptr;
+
+  // the response depends on Accept-Encoding, compressed or not
+  vary(F("Accept-Encoding"));
+
+  const auto length = get(ContentLength);
+  if (length != F("") && size_t(length.toInt()) < compressThreshold_)
+    return nullptr;
+
+  if (req.acceptsEncodings(F("gzip")))
+    return "gzip";
+  if (req.acceptsEncodings(F("deflate")))
+    return "deflate";
+  return nullptr;
+}
+
 /// @brief
-void _Response::send() {
-  auto &client = const_cast<ClientType &>(client_);
+void _Response::writeHead() {
+  // Construct headers
+  evaluateHeaders();
 
-  client.print(F("HTTP/1.1 "));
-  client.println(status_);
+  const auto encoding = negotiateCompression();
+  if (encoding) {
+    set(F("content-encoding"), encoding);
+    removeHeader(ContentLength);
+  }
 
-  // Construct headers
-  evaluateHeaders(client);
+  // no length known up front: frame the body in chunks
+  const auto framed = (streaming_ || encoding) && get(ContentLength) == F("");
+  if (framed)
+    set(F("transfer-encoding"), F("chunked"));
+
+  size_t length;
+  const auto statusLine = StatusLine::get(status_, length);
+  if (statusLine)
+    out_.write(statusLine, length);
+  else {
+    out_.print(F("HTTP/1.1 "));
+    out_.println(status_);
+  }
 
   LOG_V(F("Headers:"));
   for (auto [first, second] : headers)
@@ -374,15 +1046,170 @@ void _Response::send() {
 
   // Send headers
   for (auto [first, second] : headers) {
-    client.print(first);
-    client.print(": ");
-    client.println(second);
+    out_.print(first);
+    out_.print(F(": "));
+    out_.println(second);
   }
-  client.println();
+  for (const auto &cookie : cookies_)
+    printCookie(cookie);
+  out_.println();
 
   headersSent = true;
 
-  sendBody(client, renderLocals);
+  if (suppressBody_)
+    return;
+
+  if (framed)
+    out_.beginChunked();
+
+  if (encoding)
+    deflate_ = new Deflate(out_, (encoding[0] == 'g') ? Deflate::Format::Gzip
+                                                      : Deflate::Format::Zlib);
+}
+
+/// @brief
+/// @return
+auto _Response::sink() -> Print & {
+  if (deflate_)
+    return *deflate_;
+  return out_;
+}
+
+/// @brief Ends the body (compression, chunks) and hands the rest to the
+/// client
+void _Response::finish() {
+  if (finished_)
+    return;
+
+  if (deflate_)
+    deflate_->finish();
+
+  if (out_.chunked())
+    out_.endChunked();
+  else
+    out_.flush();
+
+  finished_ = true;
+
+  if (captured_) {
+    out_.tap(nullptr);
+    const auto done = captured_;
+    captured_ = nullptr;
+    done();
+  }
+}
+
+/// @brief
+/// @param data
+/// @param length
+auto _Response::replay(const uint8_t *data, const size_t length) -> void {
+  out_.writeThrough(data, length);
+  headersSent = true;
+  finished_ = true;
+}
+
+/// @brief
+/// @param copy
+/// @param done
+auto _Response::capture(Print &copy, const Callback done) -> void {
+  out_.tap(&copy);
+  captured_ = done;
+}
+
+/// @brief Streams (a part of) the file in fixed size pieces. Without a
+/// compressor in between, the file is read straight into the output buffer.
+/// @param out
+/// @param offset
+/// @param length
+/// @return
+auto _Response::streamFile(Print &out, const size_t offset,
+                           const size_t length) -> bool {
+  if (file_.position() != offset && !file_.seek(offset)) {
+    LOG_E(F("seek failed"), offset);
+    return false;
+  }
+
+  size_t sent;
+  if (&out == &out_)
+    sent = out_.writeFrom(file_, length);
+  else {
+    uint8_t chunk[EXPRESS_FILE_CHUNK_SIZE];
+    sent = 0;
+    while (sent < length) {
+      const auto n =
+          file_.read(chunk, std::min(sizeof(chunk), length - sent));
+      if (n <= 0)
+        break;
+      out.write(chunk, n);
+      sent += n;
+    }
+  }
+
+  if (sent != length) {
+    LOG_E(F("short read"), sent, length);
+    return false;
+  }
+
+  return true;
+}
+
+/// @brief Sends the ranges (see byteRanges) of the file, or of contents in
+/// memory, each part behind its pre-rendered header when multipart.
+/// @param out
+/// @param contents nullptr for the file
+void _Response::sendRanges(Print &out, const char *contents) {
+  const auto multipart = !partHeads_.empty();
+
+  for (size_t i = 0; i < parts_.size(); i++) {
+    if (multipart)
+      out.write(partHeads_[i].c_str(), partHeads_[i].length());
+
+    const size_t start = parts_[i].start;
+    const size_t length = parts_[i].end - parts_[i].start + 1;
+    if (contents)
+      out.write(contents + start, length);
+    else if (!streamFile(out, start, length))
+      return;
+  }
+
+  // closing delimiter
+  if (multipart)
+    out.write(partHeads_.back().c_str(), partHeads_.back().length());
+}
+
+/// @brief
+/// @param out
+void _Response::sendFileBody(Print &out) {
+  if (parts_.empty())
+    streamFile(out, 0, fileLength_);
+  else
+    sendRanges(out, nullptr);
+
+  if (keepFile_)
+    file_ = fs::File(); // the handle stays open for the next request
+  else
+    file_.close();
+}
+
+/// @brief Status line, headers and the (start of the) body are assembled in
+/// the output buffer, a small response is written to the client at once.
+void _Response::send() {
+  // sent already (replayed)
+  if (finished_)
+    return;
+
+  // a streamed body, end it when the handler did not
+  if (streaming_) {
+    end();
+    return;
+  }
+
+  writeHead();
+
+  sendBody(sink(), renderLocals);
+  rawBuffer_ = Buffer();
+
+  finish();
 }
 
 END_EXPRESS_NAMESPACE
@@ -30,10 +30,6 @@ BEGIN_EXPRESS_NAMESPACE
 /// @brief
 _Route::_Route() { LOG_T(F("_Route constructor")); }
 
-auto _Route::splitToVector(const String &path) -> void {
-  splitToVector(path, indices);
-}
-
 /// @brief
 /// @param path
 /// @return
@@ -46,7 +42,7 @@ auto _Route::splitToVector(const String &path, std::vector<PosLen> &poslens)
       p = i;
     }
   }
-  poslens.push_back({p, i - p});
+  poslens.push_back({p, path.length() - p});
 }
 
 /// @brief
@@ -25,10 +25,18 @@
 
 #include "Express.h"
 
+#include <algorithm>
+
 BEGIN_EXPRESS_NAMESPACE
 
-// static declarations
-bool _Router::gotoNext{};
+// Note: in the order of the Method enum
+static const char *const methodNames[] PROGMEM = {
+    "GET", "HEAD", "POST", "PUT", "DELETE", "CONNECT", "OPTIONS", "TRACE", "PATCH",
+};
+
+static constexpr uint16_t methodBit(const Method method) {
+  return (method == Method::ALL) ? 0xFFFF : (1 << method);
+}
 
 /// @brief Constructor
 _Router::_Router() { LOG_T(F("_Router contructor")); }
@@ -43,7 +51,6 @@ _Route &_Router::route(const String &path) {
   const auto route = new _Route();
   route->path = path;
 
-  route->splitToVector(route->path);
   // Add to collection
   routes.push_back(route);
 
@@ -51,37 +58,50 @@ _Route &_Router::route(const String &path) {
 }
 
 /// @brief
+/// @param table
 /// @param path
-/// @param pathItems
 /// @param requestPath
 /// @param requestPathItems
 /// @param params
 /// @return
-auto _Router::match(const String &path, const std::vector<PosLen> &pathItems,
-                   const String &requestPath,
-                   const std::vector<PosLen> &requestPathItems,
-                   params_t &params) -> bool {
-  if (requestPathItems.size() != pathItems.size()) {
+auto _Router::match(const RouteTable &table, const RouteTable::Path &path,
+                    const String &requestPath,
+                    const std::vector<PosLen> &requestPathItems,
+                    params_t &params) -> bool {
+  if (requestPathItems.size() != path.segmentCount) {
     return false;
   }
 
-  for (size_t i = 0; i < requestPathItems.size(); i++) {
+  const auto text = table.text.c_str();
+  const auto request = requestPath.c_str();
+  const auto segments = &table.segments[path.segmentOffset];
+
+  // compare the fixed segments first, parameters are only extracted for
+  // a matching path.
+  for (size_t i = 0; i < path.segmentCount; i++) {
+    const auto &ave = requestPathItems[i];
+    const auto &bve = segments[i];
+
+    if (bve.len > 1 && text[bve.pos + 1] == ':') // Note: : comes right after /
+      continue;
+
+    if (ave.len != bve.len ||
+        0 != memcmp(request + ave.pos, text + bve.pos, bve.len)) {
+      return false;
+    }
+  }
+
+  for (size_t i = 0; i < path.segmentCount; i++) {
     const auto &ave = requestPathItems[i];
-    const auto &bve = pathItems[i];
+    const auto &bve = segments[i];
 
-    if (path.charAt(bve.pos + 1) == ':') // Note: : comes right after /
-    {
-      auto name = path.substring(bve.pos + 2,
-                                 bve.pos + bve.len); // Note: + 2 to offset /:
+    if (bve.len > 1 && text[bve.pos + 1] == ':') {
+      auto name = table.text.substring(bve.pos + 2,
+                                       bve.pos + bve.len); // Note: + 2 to offset /:
       name.toLowerCase();
       const auto value = requestPath.substring(
           ave.pos + 1, ave.pos + ave.len); // Note + 1 to offset /
       params[name] = value;
-    } else {
-      if (requestPath.substring(ave.pos, ave.pos + ave.len) !=
-          path.substring(bve.pos, bve.pos + bve.len)) {
-        return false;
-      }
     }
   }
 
@@ -89,71 +109,361 @@ auto _Router::match(const String &path, const std::vector<PosLen> &pathItems,
 }
 
 /// @brief
-/// @param req
-/// @param res
-/// @param next
 /// @return
-auto _Router::evaluate(_Request &req, _Response &res) -> bool {
-  LOG_V(F("_Router::evaluate, req.uri:"), req.uri, F("routes:"), routes.size());
+auto _Router::frozen() -> bool {
+  auto root = this;
+  while (root->parent)
+    root = root->parent;
 
-  std::vector<PosLen> req_indices{};
-  _Route::splitToVector(req.uri, req_indices);
+  return nullptr != root->table_;
+}
+
+/// @brief
+/// @param table
+/// @param path
+/// @return
+auto _Router::intern(RouteTable &table, const String &path) -> uint16_t {
+  for (uint16_t i = 0; i < table.paths.size(); i++) {
+    const auto &other = table.paths[i];
+    if (other.length == path.length() &&
+        0 == memcmp(table.text.c_str() + other.offset, path.c_str(),
+                    other.length))
+      return i;
+  }
+
+  std::vector<PosLen> segments{};
+  _Route::splitToVector(path, segments);
+
+  const uint16_t offset = table.text.length();
+  table.text += path;
+
+  table.paths.push_back({offset, static_cast<uint16_t>(path.length()),
+                         static_cast<uint16_t>(table.segments.size()),
+                         static_cast<uint16_t>(segments.size()), 0, 0, 0});
+  for (auto [pos, len] : segments)
+    table.segments.push_back({offset + pos, len});
+
+  return table.paths.size() - 1;
+}
+
+/// @brief
+/// @param table
+/// @param chain
+/// @param parentErrorOffset
+/// @param parentErrorCount
+auto _Router::compact(RouteTable &table, std::vector<MiddlewareCallback> chain,
+                      const uint16_t parentErrorOffset,
+                      const uint16_t parentErrorCount) -> void {
+  // router wide middlewares come after the ones of the parent
+  for (const auto &middleware : middlewares)
+    chain.push_back(middleware);
+
+  // own error handlers first, then the ones of the parent
+  const uint16_t errorOffset = table.errorHandlers.size();
+  for (const auto &errorHandler : errorHandlers)
+    table.errorHandlers.push_back(errorHandler);
+  for (uint16_t i = 0; i < parentErrorCount; i++)
+    table.errorHandlers.push_back(table.errorHandlers[parentErrorOffset + i]);
+  const uint16_t errorCount = table.errorHandlers.size() - errorOffset;
 
   for (auto route : routes) {
-    if ((route->method == Method::ALL || req.method_ == route->method) &&
-        match(route->path, route->indices, req.uri, req_indices, req.params)) {
-      res.status_ = HttpStatus::OK;
-      req.route = route;
+    if (route->method == Method::UNDEFINED)
+      continue;
+
+    RouteTable::Entry entry{};
+    entry.method = route->method;
+    entry.path = intern(table, route->path);
+    entry.chainOffset = table.chain.size();
+    entry.handlerOffset = entry.chainOffset + chain.size();
+    entry.errorOffset = errorOffset;
+    entry.errorCount = errorCount;
+    entry.route = route;
+
+    table.paths[entry.path].methods |= methodBit(route->method);
+
+    for (const auto &middleware : chain)
+      table.chain.push_back(middleware);
+    for (const auto &middleware : route->middlewares)
+      table.chain.push_back(middleware);
+    entry.chainCount = table.chain.size() - entry.chainOffset;
+
+    table.entries.push_back(entry);
+
+    // the table has its own copy now
+    std::vector<MiddlewareCallback>().swap(route->middlewares);
+  }
 
-      // run the route wide middlewares
-      for (const auto middleware : route->middlewares) {
-        gotoNext = false;
-        try {
-          middleware(req, res, [gotoNext](const _Error *error) {
-            if (error) // reconstruct error message in new object
-              throw new _Error(error->message);
-            gotoNext = true;
-          });
-        } catch (_Error *error) {
-          res.status(HttpStatus::SERVER_ERROR);
-          for (const auto errorHandler : errorHandlers) {
-            errorHandler(*error, req, res,
-                         [gotoNext](const _Error *error) { gotoNext = true; });
-            if (!gotoNext)
-              break;
-          }
-          return false;
-        }
-        if (!gotoNext)
-          break;
-      }
+  LOG_V(F("compact child routers"), routers_.size());
+  for (auto [mountpath, _Router] : routers_)
+    _Router->compact(table, chain, errorOffset, errorCount);
+}
 
-      return true;
+/// @brief
+auto _Router::freeze() -> void {
+  if (nullptr != table_)
+    return;
+
+  const auto table = new RouteTable();
+
+  // app wide middlewares only, used when no route matches
+  for (const auto &middleware : middlewares)
+    table->chain.push_back(middleware);
+  table->appChainCount = table->chain.size();
+
+  // the app wide error handlers come first in the table
+  table->appErrorCount = errorHandlers.size();
+
+  compact(*table, {}, 0, 0);
+
+  // pre-render the Allow header of every path. HEAD is served by GET routes
+  // and OPTIONS is answered automatically.
+  for (auto &path : table->paths) {
+    if (path.methods & methodBit(Method::GET))
+      path.methods |= methodBit(Method::HEAD);
+    path.methods |= methodBit(Method::OPTIONS);
+
+    path.allowOffset = table->text.length();
+    for (uint16_t method = Method::GET; method <= Method::PATCH; method++) {
+      if (0 == (path.methods & (1 << method)))
+        continue;
+      if (table->text.length() > path.allowOffset)
+        table->text += F(", ");
+      table->text += methodNames[method];
     }
+    path.allowLength = table->text.length() - path.allowOffset;
   }
 
-  LOG_V(F("evaluate child routers"), routers_.size());
-  for (auto [mountpath, _Router] : routers_) {
-    if (_Router->evaluate(req, res))
-      return true;
+  // the entries of every path (in registration order), so a request only
+  // looks at the routes of its own path
+  for (const auto &entry : table->entries)
+    table->paths[entry.path].entryCount++;
+  uint16_t entryOffset = 0;
+  for (auto &path : table->paths) {
+    path.entryOffset = entryOffset;
+    entryOffset += path.entryCount;
+    path.entryCount = 0;
+  }
+  table->pathEntries.resize(table->entries.size());
+  for (uint16_t i = 0; i < table->entries.size(); i++) {
+    auto &path = table->paths[table->entries[i].path];
+    table->pathEntries[path.entryOffset + path.entryCount++] = i;
   }
 
-  return false;
+  const auto text = table->text.c_str();
+  for (uint16_t i = 0; i < table->paths.size(); i++) {
+    const auto &path = table->paths[i];
+    if (memchr(text + path.offset, ':', path.length))
+      table->paramPaths.push_back(i);
+    else
+      table->staticPaths.push_back(i);
+  }
+  std::sort(table->staticPaths.begin(), table->staticPaths.end(),
+            [table, text](const uint16_t a, const uint16_t b) {
+              const auto &pa = table->paths[a];
+              const auto &pb = table->paths[b];
+              const auto order = memcmp(text + pa.offset, text + pb.offset,
+                                        std::min(pa.length, pb.length));
+              return order < 0 || (order == 0 && pa.length < pb.length);
+            });
+
+  table->segments.shrink_to_fit();
+  table->paths.shrink_to_fit();
+  table->entries.shrink_to_fit();
+  table->pathEntries.shrink_to_fit();
+  table->staticPaths.shrink_to_fit();
+  table->paramPaths.shrink_to_fit();
+  table->chain.shrink_to_fit();
+  table->errorHandlers.shrink_to_fit();
+
+  LOG_I(F("routes frozen:"), table->entries.size(), F("paths:"),
+        table->paths.size(), F("chain:"), table->chain.size());
+
+  table_ = table;
+}
+
+/// @brief
+/// @param table
+/// @param method
+/// @param req
+/// @param requestPathItems
+/// @return
+auto _Router::find(const RouteTable &table, const Method method, _Request &req,
+                   const std::vector<PosLen> &requestPathItems)
+    -> const RouteTable::Entry * {
+  const RouteTable::Entry *best = nullptr;
+
+  const auto path = findStatic(table, req.uri);
+  if (path)
+    best = first(table, *path, method);
+
+  // a path with parameters wins when one of its routes was registered
+  // earlier. Entries are in registration order, so are their addresses.
+  params_t params{};
+  bool withParams = false;
+  for (const auto i : table.paramPaths) {
+    const auto &path = table.paths[i];
+    if (path.segmentCount != requestPathItems.size())
+      continue;
+
+    const auto candidate = first(table, path, method);
+    if (nullptr == candidate || (best && candidate >= best))
+      continue;
+
+    params_t candidateParams{};
+    if (match(table, path, req.uri, requestPathItems, candidateParams)) {
+      best = candidate;
+      params.swap(candidateParams);
+      withParams = true;
+    }
+  }
+
+  if (withParams)
+    for (const auto &[name, value] : params)
+      req.params[name] = value;
+
+  return best;
+}
+
+/// @brief
+/// @param table
+/// @param requestPath
+/// @return
+auto _Router::findStatic(const RouteTable &table, const String &requestPath)
+    -> const RouteTable::Path * {
+  const auto text = table.text.c_str();
+  const auto request = requestPath.c_str();
+  const size_t length = requestPath.length();
+
+  size_t low = 0;
+  size_t high = table.staticPaths.size();
+  while (low < high) {
+    const auto mid = (low + high) / 2;
+    const auto &path = table.paths[table.staticPaths[mid]];
+    auto order = memcmp(text + path.offset, request,
+                        std::min(size_t(path.length), length));
+    if (order == 0)
+      order = (path.length < length) ? -1 : (path.length > length) ? 1 : 0;
+    if (order == 0)
+      return &path;
+    if (order < 0)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return nullptr;
+}
+
+/// @brief
+/// @param table
+/// @param path
+/// @param method
+/// @return
+auto _Router::first(const RouteTable &table, const RouteTable::Path &path,
+                    const Method method) -> const RouteTable::Entry * {
+  for (uint16_t i = 0; i < path.entryCount; i++) {
+    const auto &entry = table.entries[table.pathEntries[path.entryOffset + i]];
+    if (entry.method == Method::ALL || method == entry.method)
+      return &entry;
+  }
+
+  return nullptr;
 }
 
 /// @brief
 auto _Router::dispatch(_Request &req, _Response &res) -> void {
-  /// @brief run the _Router wide middlewares
-  gotoNext = true;
-  for (const auto middleware : middlewares) {
+  if (nullptr == table_)
+    freeze();
+
+  const auto &table = *table_;
+
+  LOG_V(F("_Router::dispatch, req.uri:"), req.uri, F("routes:"),
+        table.entries.size());
+
+  std::vector<PosLen> req_indices{};
+  _Route::splitToVector(req.uri, req_indices);
+
+  // HEAD is answered by the GET route (when there is no HEAD route), without
+  // generating the body
+  res.suppressBody_ = (req.method_ == Method::HEAD);
+
+  auto entry = find(table, req.method_, req, req_indices);
+  if (nullptr == entry && req.method_ == Method::HEAD)
+    entry = find(table, Method::GET, req, req_indices);
+
+  // when no route matches, only the app wide middlewares are run
+  size_t offset = 0;
+  size_t end = table.appChainCount;
+  size_t handlerOffset = SIZE_MAX;
+  size_t errorOffset = 0;
+  size_t errorEnd = table.appErrorCount;
+
+  // the path exists, but not for this method: 405 or automatic OPTIONS
+  const RouteTable::Path *allow = nullptr;
+
+  if (entry) {
+    req.route = entry->route;
+    offset = entry->chainOffset;
+    end = entry->chainOffset + entry->chainCount;
+    handlerOffset = entry->handlerOffset;
+    errorOffset = entry->errorOffset;
+    errorEnd = entry->errorOffset + entry->errorCount;
+  } else {
+    allow = findStatic(table, req.uri);
+    // the params of paths that do not match stay out of req.params
+    params_t scratch;
+    for (size_t i = 0; nullptr == allow && i < table.paramPaths.size(); i++) {
+      const auto &path = table.paths[table.paramPaths[i]];
+      scratch.clear();
+      if (match(table, path, req.uri, req_indices, scratch))
+        allow = &path;
+    }
+  }
+
+  bool gotoNext = true;
+  for (auto i = offset; i < end; i++) {
+    if (i == handlerOffset)
+      res.status_ = HttpStatus::OK;
+
     gotoNext = false;
-    middleware(req, res, [gotoNext](const _Error *error) { gotoNext = true; });
+    try {
+      table.chain[i](req, res, [&gotoNext](const _Error *error) {
+        if (error) // reconstruct error message in new object
+          throw new _Error(error->message);
+        gotoNext = true;
+      });
+    } catch (_Error *error) {
+      res.status(HttpStatus::SERVER_ERROR);
+      for (auto j = errorOffset; j < errorEnd; j++) {
+        gotoNext = false;
+        table.errorHandlers[j](*error, req, res,
+                               [&gotoNext](const _Error *error) {
+                                 gotoNext = true;
+                               });
+        if (!gotoNext)
+          break;
+      }
+      delete error;
+      return;
+    }
+
     if (!gotoNext)
-      break;
+      return;
   }
 
-  if (gotoNext)
-    evaluate(req, res);
+  // a matching route without middlewares
+  if (end == handlerOffset)
+    res.status_ = HttpStatus::OK;
+
+  if (allow) {
+    res.set(F("Allow"), table.text.substring(allow->allowOffset,
+                                             allow->allowOffset +
+                                                 allow->allowLength));
+    if (req.method_ == Method::OPTIONS)
+      res.status_ = HttpStatus::NO_CONTENT;
+    else
+      res.sendStatus(HttpStatus::BAD_METHOD);
+  }
 }
 
 /// @brief
@@ -179,6 +489,14 @@ auto _Router::METHOD(const Method method, const String &path,
   _path = _mountpath + _path;
   _path.trim();
 
+  if (frozen()) {
+    LOG_E(F("Routes must be added before listen! This route is ignored:"),
+          _path);
+    // not dispatched to, only there to be returned
+    static _Route ignored{};
+    return ignored;
+  }
+
   LOG_I(F("METHOD:"), method, F("path:"), _path, F("#middlewares:"),
         middlewares.size());
 
@@ -187,7 +505,6 @@ auto _Router::METHOD(const Method method, const String &path,
   route->path = _path;
   route->middlewares = middlewares; // copy the vector
 
-  route->splitToVector(route->path);
   // Add to collection
   routes.push_back(route);
 
@@ -217,6 +534,11 @@ auto _Router::use(const std::vector<ErrorCallback> errorHandlers)
 /// @return
 auto _Router::use(const MiddlewareCallback middleware) -> void // TODO, args...
 {
+  if (frozen()) {
+    LOG_E(F("Middlewares must be added before listen! This one is ignored."));
+    return;
+  }
+
   middlewares.push_back(middleware);
 }
 
@@ -226,6 +548,11 @@ auto _Router::use(const MiddlewareCallback middleware) -> void // TODO, args...
 auto _Router::use(const std::vector<MiddlewareCallback> middlewares)
     -> void // TODO, args...
 {
+  if (frozen()) {
+    LOG_E(F("Middlewares must be added before listen! These are ignored."));
+    return;
+  }
+
   for (auto middleware : middlewares)
     this->middlewares.push_back(middleware);
 }
@@ -236,7 +563,30 @@ auto _Router::use(const std::vector<MiddlewareCallback> middlewares)
 auto _Router::use(const String &path, const MiddlewareCallback middleware)
     -> void // TODO, args...
 {
-  // TODO
+  // "/" is stored as an empty uri
+  auto mountpath = this->mountpath + path;
+  if (mountpath == F("/"))
+    mountpath = F("");
+  if (mountpath.endsWith(F("/")))
+    mountpath.remove(mountpath.length() - 1);
+
+  // owned by the middleware (and its copies)
+  const auto mounted = std::make_shared<std::pair<String, MiddlewareCallback>>(
+      mountpath, middleware);
+
+  // runs for the path and everything below it
+  use([mounted](_Request &req, _Response &res, const NextCallback next) {
+    const auto &prefix = mounted->first;
+    if (!req.uri.startsWith(prefix) ||
+        (req.uri.length() > prefix.length() &&
+         req.uri[prefix.length()] != '/')) {
+      next(nullptr);
+      return;
+    }
+
+    req.baseUrl = prefix;
+    mounted->second(req, res, next);
+  });
 }
 
 /// @brief The app.mountpath property contains one or more path patterns on
@@ -245,6 +595,12 @@ auto _Router::use(const String &path, const MiddlewareCallback middleware)
 /// @param other
 /// @return
 auto _Router::use(const String &mountpath, _Router &otherRouter) -> void {
+  if (frozen()) {
+    LOG_E(F("Routers must be added before listen! This one is ignored:"),
+          mountpath);
+    return;
+  }
+
   LOG_I(F("otherRouter:"), mountpath, otherRouter.routes.size());
 
   otherRouter.mountpath = mountpath;
@@ -0,0 +1,272 @@
+#include "serveStatic.h"
+#include "../mimeType/mimeType.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+// suffix and Content-Encoding of the variants, in order of preference
+static const char *const suffixes[ServeStatic::variants] = {"", ".gz", ".br"};
+static const char *const encodings[ServeStatic::variants] = {nullptr, "gzip",
+                                                              "br"};
+
+/// @brief Percent-decodes a path. An encoded '/' or NUL, or a ".." segment,
+/// could leave the root: those are refused.
+/// @return false when the path is not acceptable
+static auto decodePath(const String &url, String &path) -> bool {
+  auto hex = [](char c) -> int {
+    if (c >= '0' && c <= '9')
+      return c - '0';
+    c |= 0x20;
+    return (c >= 'a' && c <= 'f') ? c - 'a' + 10 : -1;
+  };
+
+  path = String();
+  path.reserve(url.length());
+  for (size_t i = 0; i < url.length(); i++) {
+    char c = url[i];
+    if (c == '%') {
+      if (i + 2 >= url.length() || hex(url[i + 1]) < 0 || hex(url[i + 2]) < 0)
+        return false;
+      c = char(hex(url[i + 1]) << 4 | hex(url[i + 2]));
+      if (c == '/' || c == '\\' || c == 0)
+        return false;
+      i += 2;
+    }
+    path += c;
+  }
+
+  return path.indexOf(F("/../")) < 0 && !path.endsWith(F("/.."));
+}
+
+/// @brief
+ServeStatic::ServeStatic(FS &fs, const String &root, Options *options)
+    : fs_(fs), root_(root), options_(options ? Options(options) : Options()) {
+  if (root_.endsWith(F("/")))
+    root_.remove(root_.length() - 1);
+}
+
+/// @brief
+auto ServeStatic::handle(_Request &req, _Response &res, const NextCallback next)
+    -> void {
+  if (req.method_ != Method::GET && req.method_ != Method::HEAD) {
+    next(nullptr);
+    return;
+  }
+
+  auto url = req.uri.startsWith(req.baseUrl)
+                 ? req.uri.substring(req.baseUrl.length())
+                 : req.uri;
+  if (url == F("")) {
+    // the mount path itself, the index file is served from its directory
+    if (req.baseUrl != F("") && options_.index != F("")) {
+      res.set(F("location"), req.uri + F("/") + req.search);
+      res.sendStatus(HttpStatus::MOVED);
+      return;
+    }
+    url = F("/");
+  }
+
+  String path;
+  if (!decodePath(url, path)) {
+    res.sendStatus(HttpStatus::FORBIDDEN);
+    return;
+  }
+
+  // a segment starting with a dot
+  if (path.indexOf(F("/.")) >= 0 && !options_.dotfiles.equals(F("allow"))) {
+    if (options_.dotfiles.equals(F("deny")))
+      res.sendStatus(HttpStatus::FORBIDDEN);
+    else
+      next(nullptr);
+    return;
+  }
+
+  auto &entry = lookup(path);
+
+  if (entry.path == F("")) {
+    // a directory, without the trailing slash: relative links in its index
+    // file would resolve against the parent
+    if (entry.directory) {
+      res.set(F("location"), req.uri + F("/") + req.search);
+      res.sendStatus(HttpStatus::MOVED);
+      return;
+    }
+
+    next(nullptr);
+    return;
+  }
+
+  uint8_t variant = 0;
+  if (entry.present & ~1) {
+    res.vary(F("Accept-Encoding"));
+    for (uint8_t v = variants - 1; v > 0; v--) {
+      if ((entry.present & (1 << v)) && req.acceptsEncodings(encodings[v])) {
+        variant = v;
+        break;
+      }
+    }
+  }
+
+  auto &file = open(entry, variant);
+  if (!file) {
+    // gone meanwhile
+    forget(entry);
+    next(nullptr);
+    return;
+  }
+
+  res.sendOpenFile(file, entry.type, entry.size[variant], encodings[variant],
+                   entry.etag[variant], entry.lastModified, entry.path,
+                   &options_, true);
+}
+
+/// @brief The entry of a URL, from the cache or the FS. The least recently
+/// used entry makes room. A URL without a file (or a directory) is not kept.
+auto ServeStatic::lookup(const String &url) -> Entry & {
+  for (auto &entry : entries_) {
+    if (entry.url == url) {
+      entry.lastUsed = ++clock_;
+      return entry;
+    }
+  }
+
+  miss_ = Entry();
+  miss_.url = url;
+  stat(miss_);
+  if (miss_.path == F(""))
+    return miss_;
+
+  if (entries_.size() >= EXPRESS_STATIC_CACHE_SIZE) {
+    size_t lru = 0;
+    for (size_t i = 1; i < entries_.size(); i++)
+      if (entries_[i].lastUsed < entries_[lru].lastUsed)
+        lru = i;
+    entries_[lru].file.close();
+    entries_.erase(entries_.begin() + lru);
+  }
+
+  entries_.push_back(std::move(miss_));
+  miss_ = Entry();
+  auto &entry = entries_.back();
+  entry.lastUsed = ++clock_;
+
+  return entry;
+}
+
+/// @brief Drops the entry of a file that is gone
+auto ServeStatic::forget(Entry &entry) -> void {
+  entry.file.close();
+  for (size_t i = 0; i < entries_.size(); i++) {
+    if (&entries_[i] == &entry) {
+      entries_.erase(entries_.begin() + i);
+      return;
+    }
+  }
+}
+
+/// @brief Finds the file of the URL and learns what there is to know about it
+auto ServeStatic::stat(Entry &entry) -> void {
+  auto path = root_ + entry.url;
+  if (path.endsWith(F("/"))) {
+    if (options_.index == F(""))
+      return;
+    path += options_.index;
+  }
+
+  auto file = fs_.open(path);
+  if (file && file.isDirectory()) {
+    file.close();
+    // redirected to the directory (with a slash), see handle()
+    entry.directory = options_.index != F("");
+    return;
+  }
+  if (!file)
+    return;
+
+  entry.path = path;
+  entry.type = MimeType::getType(path.c_str());
+  entry.mtime = file.getLastWrite();
+  if (entry.mtime > 0)
+    entry.lastModified = _Response::httpDate(entry.mtime);
+
+  // without a modification time (eg LittleFS without timestamps), the size
+  // alone would be a weak validator: the contents are hashed instead
+  for (uint8_t v = 0; v < variants; v++) {
+    size_t size;
+    uint32_t validator = uint32_t(entry.mtime);
+    if (v == 0) {
+      size = file.size();
+      if (entry.mtime == 0)
+        validator = contentsHash(file);
+    } else {
+      const auto sibling = path + suffixes[v];
+      if (!fs_.exists(sibling))
+        continue;
+      auto encoded = fs_.open(sibling);
+      if (!encoded)
+        continue;
+      size = encoded.size();
+      if (entry.mtime == 0)
+        validator = contentsHash(encoded);
+      encoded.close();
+    }
+
+    entry.present |= 1 << v;
+    entry.size[v] = size;
+    entry.etag[v] = _Response::etag(size, validator,
+                                    encodings[v] ? encodings[v] : "");
+  }
+
+  // most likely requested again soon
+  entry.file = file;
+  entry.fileVariant = 0;
+}
+
+/// @brief The (open) file of a variant. When too many handles are open, the
+/// least recently used one is closed.
+auto ServeStatic::open(Entry &entry, const uint8_t variant) -> fs::File & {
+  if (entry.file && entry.fileVariant == variant)
+    return entry.file;
+
+  entry.file.close();
+
+  while (true) {
+    size_t count = 0;
+    Entry *lru = nullptr;
+    for (auto &other : entries_) {
+      if (!other.file)
+        continue;
+      count++;
+      if (nullptr == lru || other.lastUsed < lru->lastUsed)
+        lru = &other;
+    }
+    if (count < EXPRESS_STATIC_OPEN_FILES || nullptr == lru)
+      break;
+    lru->file.close();
+  }
+
+  entry.file = fs_.open(entry.path + suffixes[variant]);
+  entry.fileVariant = variant;
+
+  return entry.file;
+}
+
+/// @brief Hash of the contents of a file, read in chunks. The file is left at
+/// its start.
+auto ServeStatic::contentsHash(fs::File &file) -> uint32_t {
+  uint8_t chunk[256];
+  auto hash = _Response::hash(nullptr, 0);
+  int length;
+  while ((length = file.read(chunk, sizeof(chunk))) > 0)
+    hash = _Response::hash(chunk, length, hash);
+  file.seek(0);
+  return hash;
+}
+
+/// @brief
+auto ServeStatic::clear() -> void {
+  for (auto &entry : entries_)
+    entry.file.close();
+  entries_.clear();
+}
+
+END_EXPRESS_NAMESPACE
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "../Express.h"
+
+/// @brief Number of files (and misses) whose metadata is kept
+#ifndef EXPRESS_STATIC_CACHE_SIZE
+#define EXPRESS_STATIC_CACHE_SIZE 16
+#endif
+
+/// @brief Number of file handles kept open, for the most recently served
+/// files. Each one costs a file descriptor (and buffer) of the FS.
+#ifndef EXPRESS_STATIC_OPEN_FILES
+#define EXPRESS_STATIC_OPEN_FILES 2
+#endif
+
+BEGIN_EXPRESS_NAMESPACE
+
+/// @brief Serves the files below a root directory of a FS (see
+/// _Express::Static). What is learned about a file (the path it maps to, its
+/// size, modification time, MIME type, ETag and pre-compressed siblings) is
+/// cached, so a repeated request does not touch the FS until the file is
+/// read. The handles of the most recently served files are kept open. Call
+/// clear() when the files change. A URL without a file is not cached, a file
+/// that is added later is found.
+class ServeStatic {
+public:
+  /// @brief identity, .gz and .br
+  static constexpr uint8_t variants = 3;
+
+private:
+  struct Entry {
+    /// @brief URL below the mount path
+    String url;
+    /// @brief file on the FS (index file resolved), empty when not found
+    String path;
+    const char *type = nullptr;
+    time_t mtime = 0;
+    String lastModified;
+    size_t size[variants] = {};
+    String etag[variants];
+    /// @brief bit per variant
+    uint8_t present = 0;
+    /// @brief the URL names a directory (without trailing slash)
+    bool directory = false;
+
+    /// @brief open handle and its variant
+    fs::File file;
+    uint8_t fileVariant = 0;
+
+    uint32_t lastUsed = 0;
+  };
+
+  FS &fs_;
+  String root_;
+  Options options_;
+
+  std::vector<Entry> entries_;
+  uint32_t clock_ = 0;
+
+  /// @brief the last URL without a file (not cached)
+  Entry miss_;
+
+  auto lookup(const String &url) -> Entry &;
+  auto forget(Entry &entry) -> void;
+  auto stat(Entry &entry) -> void;
+  auto open(Entry &entry, const uint8_t variant) -> fs::File &;
+  static auto contentsHash(fs::File &file) -> uint32_t;
+
+public:
+  ServeStatic(FS &fs, const String &root, Options *options = nullptr);
+
+  /// @brief
+  auto handle(_Request &req, _Response &res, const NextCallback next) -> void;
+
+  /// @brief Forgets what is cached (and closes the handles), eg after the
+  /// files have been updated
+  auto clear() -> void;
+};
+
+END_EXPRESS_NAMESPACE
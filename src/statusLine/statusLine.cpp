@@ -0,0 +1,120 @@
+#include "statusLine.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+namespace {
+
+struct entry {
+  uint16_t code;
+  uint8_t length;
+  const char *line;
+};
+
+// "HTTP/1.1 " + 3 digit code + " "
+constexpr size_t reasonOffset = 13;
+
+#define STATUS_LINE(code, reason)                                              \
+  { code, sizeof("HTTP/1.1 " #code " " reason "\r\n") - 1,                      \
+    "HTTP/1.1 " #code " " reason "\r\n" }
+
+// Note: sorted on code (binary search)
+constexpr entry lines[] PROGMEM = {
+    STATUS_LINE(100, "Continue"),
+    STATUS_LINE(101, "Switching Protocols"),
+    STATUS_LINE(102, "Processing"),
+    STATUS_LINE(103, "Early Hints"),
+    STATUS_LINE(200, "OK"),
+    STATUS_LINE(201, "Created"),
+    STATUS_LINE(202, "Accepted"),
+    STATUS_LINE(203, "Non-Authoritative Information"),
+    STATUS_LINE(204, "No Content"),
+    STATUS_LINE(205, "Reset Content"),
+    STATUS_LINE(206, "Partial Content"),
+    STATUS_LINE(207, "Multi-Status"),
+    STATUS_LINE(208, "Already Reported"),
+    STATUS_LINE(300, "Multiple Choices"),
+    STATUS_LINE(301, "Moved Permanently"),
+    STATUS_LINE(302, "Found"),
+    STATUS_LINE(303, "See Other"),
+    STATUS_LINE(304, "Not Modified"),
+    STATUS_LINE(305, "Use Proxy"),
+    STATUS_LINE(307, "Temporary Redirect"),
+    STATUS_LINE(400, "Bad Request"),
+    STATUS_LINE(401, "Unauthorized"),
+    STATUS_LINE(402, "Payment Required"),
+    STATUS_LINE(403, "Forbidden"),
+    STATUS_LINE(404, "Not Found"),
+    STATUS_LINE(405, "Method Not Allowed"),
+    STATUS_LINE(406, "Not Acceptable"),
+    STATUS_LINE(407, "Proxy Authentication Required"),
+    STATUS_LINE(408, "Request Timeout"),
+    STATUS_LINE(409, "Conflict"),
+    STATUS_LINE(410, "Gone"),
+    STATUS_LINE(411, "Length Required"),
+    STATUS_LINE(412, "Precondition Failed"),
+    STATUS_LINE(413, "Payload Too Large"),
+    STATUS_LINE(414, "URI Too Long"),
+    STATUS_LINE(415, "Unsupported Media Type"),
+    STATUS_LINE(416, "Range Not Satisfiable"),
+    STATUS_LINE(417, "Expectation Failed"),
+    STATUS_LINE(418, "I'm a Teapot"),
+    STATUS_LINE(449, "Retry With"),
+    STATUS_LINE(500, "Internal Server Error"),
+    STATUS_LINE(501, "Not Implemented"),
+    STATUS_LINE(502, "Bad Gateway"),
+    STATUS_LINE(503, "Service Unavailable"),
+    STATUS_LINE(504, "Gateway Timeout"),
+    STATUS_LINE(505, "HTTP Version Not Supported"),
+    STATUS_LINE(506, "Variant Also Negotiates"),
+    STATUS_LINE(507, "Insufficient Storage"),
+    STATUS_LINE(508, "Loop Detected"),
+    STATUS_LINE(510, "Not Extended"),
+};
+
+#undef STATUS_LINE
+
+constexpr bool sorted(size_t i = 1) {
+  return (i >= sizeof(lines) / sizeof(*lines))
+             ? true
+             : (lines[i - 1].code < lines[i].code) && sorted(i + 1);
+}
+static_assert(sorted(), "status lines must be sorted on code");
+
+const entry *find(const HttpStatus status) {
+  int min = 0;
+  int max = (sizeof(lines) / sizeof(*lines)) - 1;
+
+  while (min <= max) {
+    const int i = (min + max) / 2;
+    if (lines[i].code == status)
+      return &lines[i];
+    if (lines[i].code < status)
+      min = i + 1;
+    else
+      max = i - 1;
+  }
+
+  return nullptr;
+}
+
+} // namespace
+
+const char *StatusLine::get(const HttpStatus status, size_t &length) {
+  const auto line = find(status);
+  if (nullptr == line)
+    return nullptr;
+
+  length = line->length;
+  return line->line;
+}
+
+const char *StatusLine::reason(const HttpStatus status, size_t &length) {
+  const auto line = find(status);
+  if (nullptr == line)
+    return nullptr;
+
+  length = line->length - reasonOffset - 2; // - CRLF
+  return line->line + reasonOffset;
+}
+
+END_EXPRESS_NAMESPACE
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "../defs.h"
+
+BEGIN_EXPRESS_NAMESPACE
+
+/// @brief Pre-rendered HTTP/1.1 status lines, eg "HTTP/1.1 404 Not Found\r\n",
+/// in a table that is built at compile time (and lives in flash).
+class StatusLine {
+public:
+  /// @brief
+  /// @param status
+  /// @param length length of the status line, including the CRLF
+  /// @return the status line, or nullptr for an unknown status
+  static const char *get(const HttpStatus status, size_t &length);
+
+  /// @brief
+  /// @param status
+  /// @param length length of the reason phrase
+  /// @return the reason phrase (not null terminated!), or nullptr for an
+  /// unknown status
+  static const char *reason(const HttpStatus status, size_t &length);
+};
+
+END_EXPRESS_NAMESPACE
@@ -0,0 +1,187 @@
+/*!
+ *  @file       inlineFunction.h
+ *  Project     Arduino Express Library
+ *  @brief      Fast, unopinionated, (very) minimalist web framework for Arduino
+ *  @author     lathoub
+ *  @date       20/01/23
+ *  @license    GNU GENERAL PUBLIC LICENSE
+ *
+ *   Fast, unopinionated, (very) minimalist web framework for Arduino.
+ *   Copyright (C) 2023 lathoub
+ *
+ *   This program is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 3 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <new>
+#include <stddef.h>
+#include <string.h>
+#include <type_traits>
+#include <utility>
+
+#include "../namespace.h"
+
+/// @brief Size (in bytes) of the inline storage of every callback. A
+/// callable (lambda with its captures, functor, function pointer) must fit in
+/// here, it is never moved to the heap. Override before including Express.h
+/// if you need to capture more state (or capture a pointer to it).
+#ifndef EXPRESS_CALLBACK_STORAGE
+#define EXPRESS_CALLBACK_STORAGE (4 * sizeof(void *))
+#endif
+
+BEGIN_EXPRESS_NAMESPACE
+
+template <typename Signature, size_t Capacity = EXPRESS_CALLBACK_STORAGE>
+class InlineFunction;
+
+/// @brief Type-erased callable, like std::function, but the target is stored
+/// in a fixed-size buffer inside the object. Constructing, copying and calling
+/// never allocate. Plain function pointers and captureless lambdas keep
+/// working as before, lambdas can now also capture (per-route) state.
+template <typename R, typename... Args, size_t Capacity>
+class InlineFunction<R(Args...), Capacity> {
+private:
+  enum class Op { Copy, Destroy };
+
+  using Invoker = R (*)(void *, Args...);
+  using Manager = void (*)(Op, void *, const void *);
+
+  /// @brief SFINAE helper: T can be called as R(Args...)
+  template <typename T, typename = void>
+  struct isCallable : std::false_type {};
+
+  template <typename T>
+  struct isCallable<
+      T, typename std::enable_if<
+             std::is_void<R>::value ||
+             std::is_convertible<decltype(std::declval<T &>()(
+                                     std::declval<Args>()...)),
+                                 R>::value>::type>
+      : std::true_type {};
+
+  template <typename T>
+  using enableIfCallable = typename std::enable_if<
+      !std::is_same<typename std::decay<T>::type, InlineFunction>::value &&
+          isCallable<typename std::decay<T>::type>::value,
+      int>::type;
+
+  /// @brief
+  template <typename T> static R invoke(void *storage, Args... args) {
+    return (*static_cast<T *>(storage))(std::forward<Args>(args)...);
+  }
+
+  /// @brief copy and destroy for callables that are not trivially copyable
+  /// (eg lambdas capturing a String). Trivial callables have no manager.
+  template <typename T>
+  static void manage(Op op, void *dst, const void *src) {
+    if (op == Op::Copy)
+      new (dst) T(*static_cast<const T *>(src));
+    else
+      static_cast<T *>(dst)->~T();
+  }
+
+  template <typename T> static bool isNull(T *ptr) { return nullptr == ptr; }
+  template <typename T> static bool isNull(const T &) { return false; }
+
+  alignas(double) unsigned char storage_[Capacity];
+  Invoker invoke_ = nullptr;
+  Manager manage_ = nullptr;
+
+  void copyFrom(const InlineFunction &other) {
+    invoke_ = other.invoke_;
+    manage_ = other.manage_;
+    if (manage_)
+      manage_(Op::Copy, storage_, other.storage_);
+    else if (invoke_)
+      memcpy(storage_, other.storage_, Capacity);
+  }
+
+  void reset() {
+    if (manage_)
+      manage_(Op::Destroy, storage_, nullptr);
+    invoke_ = nullptr;
+    manage_ = nullptr;
+  }
+
+public:
+  /// @brief empty callback
+  InlineFunction() {}
+
+  /// @brief empty callback
+  InlineFunction(std::nullptr_t) {}
+
+  /// @brief Wraps any callable with a compatible signature
+  template <typename T, enableIfCallable<T> = 0> InlineFunction(T &&f) {
+    using Fn = typename std::decay<T>::type;
+
+    static_assert(sizeof(Fn) <= Capacity,
+                  "callback captures too much state: capture a pointer or "
+                  "increase EXPRESS_CALLBACK_STORAGE");
+    static_assert(alignof(Fn) <= alignof(double),
+                  "callback alignment not supported");
+
+    if (isNull(f))
+      return;
+
+    new (storage_) Fn(std::forward<T>(f));
+    invoke_ = &invoke<Fn>;
+    if (!std::is_trivially_copyable<Fn>::value ||
+        !std::is_trivially_destructible<Fn>::value)
+      manage_ = &manage<Fn>;
+  }
+
+  /// @brief Copy constructor
+  InlineFunction(const InlineFunction &other) { copyFrom(other); }
+
+  /// @brief
+  InlineFunction &operator=(const InlineFunction &other) {
+    if (this != &other) {
+      reset();
+      copyFrom(other);
+    }
+    return *this;
+  }
+
+  /// @brief
+  InlineFunction &operator=(std::nullptr_t) {
+    reset();
+    return *this;
+  }
+
+  ~InlineFunction() { reset(); }
+
+  /// @brief Calls the stored callable (which must not be empty)
+  R operator()(Args... args) const {
+    return invoke_(const_cast<unsigned char *>(storage_),
+                   std::forward<Args>(args)...);
+  }
+
+  explicit operator bool() const { return nullptr != invoke_; }
+
+  friend bool operator==(const InlineFunction &f, std::nullptr_t) {
+    return !f;
+  }
+  friend bool operator==(std::nullptr_t, const InlineFunction &f) {
+    return !f;
+  }
+  friend bool operator!=(const InlineFunction &f, std::nullptr_t) {
+    return !!f;
+  }
+  friend bool operator!=(std::nullptr_t, const InlineFunction &f) {
+    return !!f;
+  }
+};
+
+END_EXPRESS_NAMESPACE